@@ -0,0 +1,360 @@
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <new>
+#include <random>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <unistd.h>
+#include "include/evaluator.h"
+#include "include/categorizer.h"
+#include "include/expression_processor.h"
+#include "include/file_reader.h"
+#include "include/formatter.h"
+#include "include/result_writer.h"
+#include "include/workload_generator.h"
+
+// Every heap allocation in this process goes through here, so each stage can report
+// allocations per expression
+static std::atomic<size_t> allocationCount{0};
+
+void* operator new(size_t size) {
+    allocationCount.fetch_add(1, std::memory_order_relaxed);
+    if (void* p = std::malloc(size ? size : 1)) return p;
+    throw std::bad_alloc();
+}
+void operator delete(void* p) noexcept { std::free(p); }
+void operator delete(void* p, size_t) noexcept { std::free(p); }
+
+// One measured stage; a null value means "not measured" (e.g. allocations of a child process)
+struct StageResult {
+    std::string name;
+    double nsPerExpr = 0.0;
+    double mbPerSecond = 0.0;
+    double allocsPerExpr = -1.0;
+};
+
+// Run body `repeat` times and keep the fastest run. items and bytes are what one run processes.
+StageResult measure(const std::string& name, int repeat, size_t items, size_t bytes,
+                    const std::function<void()>& body, bool countAllocations = true) {
+    StageResult result;
+    result.name = name;
+    double best = 0.0;
+    size_t fewestAllocations = 0;
+    for (int run = 0; run < repeat; run++) {
+        size_t allocationsBefore = allocationCount.load(std::memory_order_relaxed);
+        auto start = std::chrono::steady_clock::now();
+        body();
+        auto stop = std::chrono::steady_clock::now();
+        size_t allocations = allocationCount.load(std::memory_order_relaxed) - allocationsBefore;
+        double seconds = std::chrono::duration<double>(stop - start).count();
+        if (run == 0 || seconds < best) best = seconds;
+        if (run == 0 || allocations < fewestAllocations) fewestAllocations = allocations;
+    }
+    if (items == 0) items = 1;
+    result.nsPerExpr = best * 1e9 / items;
+    result.mbPerSecond = best > 0.0 ? bytes / best / 1e6 : 0.0;
+    if (countAllocations) result.allocsPerExpr = static_cast<double>(fewestAllocations) / items;
+    return result;
+}
+
+// Run a shell command; a non-zero exit fails the benchmark
+void runCommand(const std::string& command) {
+    if (std::system(command.c_str()) != 0) {
+        throw std::runtime_error("Benchmark command failed: " + command);
+    }
+}
+
+// Single-quote text for sh; a ' inside it becomes '\''
+std::string quote(const std::string& text) {
+    std::string out = "'";
+    for (char c : text) {
+        if (c == '\'') out += "'\\''";
+        else out += c;
+    }
+    return out + "'";
+}
+
+// Scratch directory for the workload files, removed however main() leaves its scope
+struct WorkDirectory {
+    std::filesystem::path path;
+
+    WorkDirectory() : path(std::filesystem::temp_directory_path() /
+                           ("bench_calculator." + std::to_string(getpid()))) {
+        std::filesystem::create_directories(path);
+    }
+    ~WorkDirectory() {
+        std::error_code ignored;
+        std::filesystem::remove_all(path, ignored);
+    }
+    WorkDirectory(const WorkDirectory&) = delete;
+    WorkDirectory& operator=(const WorkDirectory&) = delete;
+};
+
+std::string jsonNumber(double value) {
+    char buffer[64];
+    snprintf(buffer, sizeof(buffer), "%.3f", value);
+    return buffer;
+}
+
+std::string jsonString(const std::string& text) {
+    std::string out = "\"";
+    for (char c : text) {
+        if (c == '"' || c == '\\') out += '\\';
+        out += c;
+    }
+    return out + "\"";
+}
+
+void printUsage(const char* programName) {
+    std::cerr << "Usage: " << programName << " [options]" << std::endl;
+    std::cerr << "  --expressions N     calculator input lines (default 100000)" << std::endl;
+    std::cerr << "  --sessions N        session blocks (default 10000)" << std::endl;
+    std::cerr << "  --length N          operands per expression (default 8)" << std::endl;
+    std::cerr << "  --depth N           maximum nesting depth (default 2)" << std::endl;
+    std::cerr << "  --variables N       distinct variables (default 8)" << std::endl;
+    std::cerr << "  --hex-share F       share of hex/binary literals, 0..1 (default 0.1)" << std::endl;
+    std::cerr << "  --function-share F  share of sin()/cos() operands, 0..1 (default 0.1)" << std::endl;
+    std::cerr << "  --seed N            workload seed (default 42)" << std::endl;
+    std::cerr << "  --repeat N          runs per stage, the fastest is reported (default 5)" << std::endl;
+    std::cerr << "  --calculator PATH   calculator binary for the end-to-end run (default ./calculator)" << std::endl;
+    std::cerr << "  --session-analyzer PATH  session_analyzer binary (default ./session_analyzer)" << std::endl;
+    std::cerr << "  --label TEXT        free-form label stored in the report (e.g. a commit id)" << std::endl;
+    std::cerr << "  -o, --output FILE   write the JSON report to FILE instead of stdout" << std::endl;
+}
+
+int main(int argc, char* argv[]) {
+    try {
+        WorkloadOptions options;
+        int repeat = 5;
+        std::string calculatorPath = "./calculator";
+        std::string analyzerPath = "./session_analyzer";
+        std::string label;
+        std::string reportFile;
+
+        for (int i = 1; i < argc; i++) {
+            std::string arg = argv[i];
+            if (i + 1 >= argc) {
+                printUsage(argv[0]);
+                return 1;
+            }
+            std::string value = argv[++i];
+            if (arg == "--expressions") options.expressions = std::stoul(value);
+            else if (arg == "--sessions") options.sessions = std::stoul(value);
+            else if (arg == "--length") options.length = std::max(1, std::stoi(value));
+            else if (arg == "--depth") options.depth = std::stoi(value);
+            else if (arg == "--variables") options.variables = std::stoi(value);
+            else if (arg == "--hex-share") options.hexShare = std::stod(value);
+            else if (arg == "--function-share") options.functionShare = std::stod(value);
+            else if (arg == "--seed") options.seed = std::stoull(value);
+            else if (arg == "--repeat") repeat = std::max(1, std::stoi(value));
+            else if (arg == "--calculator") calculatorPath = value;
+            else if (arg == "--session-analyzer") analyzerPath = value;
+            else if (arg == "--label") label = value;
+            else if (arg == "-o" || arg == "--output") reportFile = value;
+            else {
+                printUsage(argv[0]);
+                return 1;
+            }
+        }
+
+        // Step 1: Generate the workload and write it where the binaries can read it
+        WorkloadGenerator generator(options);
+        std::string calculatorText = generator.calculatorInput();
+        std::string sessionText = generator.sessionInput();
+
+        WorkDirectory workDir;
+        std::string inputFile = (workDir.path / "input.txt").string();
+        std::string sessionFile = (workDir.path / "sessions.txt").string();
+        std::string outputFile = (workDir.path / "output.txt").string();
+        std::ofstream(inputFile, std::ios::binary) << calculatorText;
+        std::ofstream(sessionFile, std::ios::binary) << sessionText;
+
+        MappedFile input = FileReader::openInput(inputFile);
+        std::vector<std::string_view> expressions = FileReader::readExpressions(input);
+        size_t count = expressions.size();
+        size_t bytes = calculatorText.size();
+
+        // Step 2: Measure each stage in isolation
+        std::vector<StageResult> stages;
+
+        // Parse: text -> stack-machine program
+        {
+            Parser parser;
+            CompiledExpr program;
+            stages.push_back(measure("parse", repeat, count, bytes, [&] {
+                for (std::string_view expression : expressions) {
+                    try { parser.compile(expression, program); } catch (const std::exception&) {}
+                }
+            }));
+        }
+
+        // Evaluate: run programs compiled up front (interpreter, then with the JIT tier)
+        Evaluator evaluator;
+        std::vector<CompiledExpr> programs;
+        programs.reserve(count);
+        for (std::string_view expression : expressions) {
+            try { programs.push_back(evaluator.compile(expression)); } catch (const std::exception&) {}
+        }
+        for (const CompiledExpr& program : programs) {
+            try { evaluator.execute(program); } catch (const std::exception&) {}
+        }
+        std::vector<double> values(programs.size());
+        auto executeAll = [&] {
+            for (size_t i = 0; i < programs.size(); i++) {
+                try { values[i] = evaluator.execute(programs[i]); } catch (const std::exception&) {}
+            }
+        };
+        evaluator.setJitEnabled(false);
+        stages.push_back(measure("evaluate", repeat, programs.size(), bytes, executeAll));
+        if (JitCompiler::isSupported()) {
+            evaluator.setJitEnabled(true);
+            evaluator.setJitThreshold(0);
+            executeAll();  // compile everything to native code before timing
+            stages.push_back(measure("evaluate_jit", repeat, programs.size(), bytes, executeAll));
+            evaluator.setJitEnabled(false);
+        }
+
+        // Batch: one formula over columns of variable values, against a scalar loop that
+        // sets the variables and executes the program once per row. The results must match
+        // bit for bit.
+        {
+            size_t rows = std::max<size_t>(options.expressions, 1);
+            std::mt19937_64 random(options.seed);
+            std::uniform_real_distribution<double> distribution(-100.0, 100.0);
+            std::vector<double> p(rows), q(rows), r(rows);
+            for (size_t i = 0; i < rows; i++) {
+                p[i] = distribution(random);
+                q[i] = distribution(random);
+                r[i] = distribution(random);
+            }
+            Evaluator batchEvaluator;
+            batchEvaluator.setJitEnabled(false);
+            CompiledExpr formula = batchEvaluator.compile("(p + q) * r / (p - q) + sin(p) ^ 2 - cos(q)");
+            ColumnMap columns = {{"p", p.data()}, {"q", q.data()}, {"r", r.data()}};
+            std::vector<double> scalar(rows), batch(rows);
+            size_t columnBytes = 3 * rows * sizeof(double);
+            stages.push_back(measure("evaluate_scalar_rows", repeat, rows, columnBytes, [&] {
+                for (size_t i = 0; i < rows; i++) {
+                    batchEvaluator.setVariable("p", p[i]);
+                    batchEvaluator.setVariable("q", q[i]);
+                    batchEvaluator.setVariable("r", r[i]);
+                    scalar[i] = batchEvaluator.execute(formula);
+                }
+            }));
+            stages.push_back(measure("evaluate_batch", repeat, rows, columnBytes, [&] {
+                batchEvaluator.evaluateBatch(formula, columns, rows, batch.data());
+            }));
+            for (size_t i = 0; i < rows; i++) {
+                if (std::memcmp(&scalar[i], &batch[i], sizeof(double)) != 0) {
+                    throw std::runtime_error("Batch result differs from the scalar path in row " +
+                                             std::to_string(i));
+                }
+            }
+        }
+
+        // Categorize: feature bits -> category
+        std::vector<unsigned> features;
+        features.reserve(programs.size());
+        for (const CompiledExpr& program : programs) features.push_back(program.features);
+        std::vector<Categorizer::Category> categories(features.size());
+        stages.push_back(measure("categorize", repeat, features.size(), bytes, [&] {
+            for (size_t i = 0; i < features.size(); i++) categories[i] = Categorizer::categorize(features[i]);
+        }));
+
+        // Format: "expression = value" into a reused buffer
+        {
+            std::string output;
+            size_t n = std::min(values.size(), expressions.size());
+            stages.push_back(measure("format", repeat, n, bytes, [&] {
+                for (size_t i = 0; i < n; i++) {
+                    output.clear();
+                    Formatter::appendResult(output, expressions[i], values[i],
+                                            Formatter::hasDecimalPoint(expressions[i]));
+                }
+            }));
+        }
+
+        // Write: categorized results -> output file
+        {
+            CategoryResults results = ExpressionProcessor::processExpressions(expressions, evaluator);
+            size_t resultCount = results.basicCalc.size() + results.hexBinary.size() +
+                                 results.variables.size() + results.advanced.size();
+            ResultWriter::writeResults(outputFile, results);
+            size_t outputBytes = std::filesystem::file_size(outputFile);
+            stages.push_back(measure("write", repeat, resultCount, outputBytes, [&] {
+                ResultWriter::writeResults(outputFile, results);
+            }));
+        }
+
+        // Whole in-process pipeline: evaluate + categorize + format + collect
+        stages.push_back(measure("process", repeat, count, bytes, [&] {
+            Evaluator fresh;
+            ExpressionProcessor::processExpressions(expressions, fresh);
+        }));
+
+        // Step 3: End-to-end runs of the real binaries, when they are available
+        if (std::filesystem::exists(calculatorPath)) {
+            std::string command = quote(calculatorPath) + " -o " + quote(outputFile) + " " +
+                                  quote(inputFile) + " > /dev/null";
+            stages.push_back(measure("end_to_end_calculator", repeat, count, bytes,
+                                     [&] { runCommand(command); }, false));
+        } else {
+            std::cerr << "Skipping end-to-end calculator run: " << calculatorPath << " not found" << std::endl;
+        }
+        if (std::filesystem::exists(analyzerPath)) {
+            std::string command = quote(analyzerPath) + " " + quote(sessionFile) + " > /dev/null";
+            stages.push_back(measure("end_to_end_session_analyzer", repeat, options.sessions,
+                                     sessionText.size(), [&] { runCommand(command); }, false));
+        } else {
+            std::cerr << "Skipping end-to-end session_analyzer run: " << analyzerPath << " not found" << std::endl;
+        }
+
+        // Step 4: Report. Field names are stable so reports can be diffed across commits;
+        // end-to-end stages count sessions rather than expressions for session_analyzer.
+        std::ostringstream report;
+        report << "{\n";
+        report << "  \"benchmark\": \"bench_calculator\",\n";
+        report << "  \"label\": " << jsonString(label) << ",\n";
+        report << "  \"workload\": {\"expressions\": " << count
+               << ", \"bytes\": " << bytes
+               << ", \"sessions\": " << options.sessions
+               << ", \"session_bytes\": " << sessionText.size()
+               << ", \"length\": " << options.length
+               << ", \"depth\": " << options.depth
+               << ", \"variables\": " << options.variables
+               << ", \"hex_share\": " << jsonNumber(options.hexShare)
+               << ", \"function_share\": " << jsonNumber(options.functionShare)
+               << ", \"seed\": " << options.seed
+               << ", \"repeat\": " << repeat << "},\n";
+        report << "  \"stages\": [\n";
+        for (size_t i = 0; i < stages.size(); i++) {
+            const StageResult& stage = stages[i];
+            report << "    {\"name\": " << jsonString(stage.name)
+                   << ", \"ns_per_expr\": " << jsonNumber(stage.nsPerExpr)
+                   << ", \"mb_per_s\": " << jsonNumber(stage.mbPerSecond)
+                   << ", \"allocs_per_expr\": "
+                   << (stage.allocsPerExpr < 0 ? std::string("null") : jsonNumber(stage.allocsPerExpr))
+                   << "}" << (i + 1 < stages.size() ? "," : "") << "\n";
+        }
+        report << "  ]\n}\n";
+
+        if (reportFile.empty()) {
+            std::cout << report.str();
+        } else {
+            std::ofstream(reportFile) << report.str();
+        }
+        return 0;
+    } catch (const std::exception& e) {
+        std::cerr << "Error: " << e.what() << std::endl;
+        return 1;
+    }
+}
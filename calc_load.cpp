@@ -0,0 +1,198 @@
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <deque>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#include "include/text_utils.h"
+#include "include/workload_generator.h"
+
+using Clock = std::chrono::steady_clock;
+
+// What one client measured
+struct ClientResult {
+    std::vector<double> latenciesUs;  // request sent -> response line received
+    size_t errors = 0;                // "Error: ..." responses
+    std::string failure;              // connection problem, if any
+};
+
+void printUsage(const char* programName) {
+    std::cerr << "Usage: " << programName << " --socket PATH [options]" << std::endl;
+    std::cerr << "  --clients N     concurrent connections (default 8)" << std::endl;
+    std::cerr << "  --requests N    expressions per connection (default 10000)" << std::endl;
+    std::cerr << "  --pipeline N    requests in flight per connection (default 16)" << std::endl;
+    std::cerr << "  --length N      operands per expression (default 8)" << std::endl;
+    std::cerr << "  --depth N       maximum nesting depth (default 2)" << std::endl;
+    std::cerr << "  --seed N        workload seed (default 42)" << std::endl;
+}
+
+int connectTo(const std::string& path) {
+    sockaddr_un address{};
+    address.sun_family = AF_UNIX;
+    if (path.size() >= sizeof(address.sun_path)) return -1;
+    std::memcpy(address.sun_path, path.c_str(), path.size() + 1);
+    int fd = ::socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (fd < 0) return -1;
+    if (::connect(fd, reinterpret_cast<sockaddr*>(&address), sizeof(address)) < 0) {
+        ::close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+// Send the lines over one connection, keeping up to `pipeline` requests in flight,
+// and time each request until its response line arrives
+ClientResult runClient(const std::string& path, const std::vector<std::string>& lines, size_t pipeline) {
+    ClientResult result;
+    int fd = connectTo(path);
+    if (fd < 0) {
+        result.failure = "could not connect to " + path + ": " + std::strerror(errno);
+        return result;
+    }
+
+    result.latenciesUs.reserve(lines.size());
+    std::deque<Clock::time_point> inFlight;
+    std::string received;
+    char chunk[64 * 1024];
+    size_t next = 0;
+
+    while (next < lines.size() || !inFlight.empty()) {
+        // Top up the pipeline with one write
+        std::string batch;
+        while (next < lines.size() && inFlight.size() < pipeline) {
+            batch.append(lines[next++]).push_back('\n');
+            inFlight.push_back(Clock::now());
+        }
+        for (size_t done = 0; done < batch.size(); ) {
+            ssize_t n = ::send(fd, batch.data() + done, batch.size() - done, MSG_NOSIGNAL);
+            if (n < 0) {
+                if (errno == EINTR) continue;
+                result.failure = std::string("send: ") + std::strerror(errno);
+                ::close(fd);
+                return result;
+            }
+            done += static_cast<size_t>(n);
+        }
+
+        // Wait for at least one response line
+        ssize_t n = ::recv(fd, chunk, sizeof(chunk), 0);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) {
+            result.failure = n == 0 ? "server closed the connection" : std::string("recv: ") + std::strerror(errno);
+            ::close(fd);
+            return result;
+        }
+        Clock::time_point now = Clock::now();
+        received.append(chunk, static_cast<size_t>(n));
+
+        size_t pos = 0;
+        std::string_view line;
+        for (size_t end; (end = received.find('\n', pos)) != std::string::npos; pos = end + 1) {
+            line = std::string_view(received).substr(pos, end - pos);
+            if (line.compare(0, 7, "Error: ") == 0) result.errors++;
+            if (inFlight.empty()) {
+                result.failure = "more responses than requests";
+                ::close(fd);
+                return result;
+            }
+            result.latenciesUs.push_back(std::chrono::duration<double, std::micro>(now - inFlight.front()).count());
+            inFlight.pop_front();
+        }
+        received.erase(0, pos);
+    }
+
+    ::close(fd);
+    return result;
+}
+
+double percentile(const std::vector<double>& sorted, double fraction) {
+    if (sorted.empty()) return 0.0;
+    size_t index = static_cast<size_t>(fraction * (sorted.size() - 1) + 0.5);
+    return sorted[std::min(index, sorted.size() - 1)];
+}
+
+int main(int argc, char* argv[]) {
+    try {
+        std::string socketPath;
+        size_t clients = 8;
+        size_t requests = 10000;
+        size_t pipeline = 16;
+        WorkloadOptions options;
+
+        for (int i = 1; i < argc; i++) {
+            std::string arg = argv[i];
+            if (i + 1 >= argc) {
+                printUsage(argv[0]);
+                return 1;
+            }
+            std::string value = argv[++i];
+            if (arg == "--socket") socketPath = value;
+            else if (arg == "--clients") clients = std::max<size_t>(1, std::stoul(value));
+            else if (arg == "--requests") requests = std::stoul(value);
+            else if (arg == "--pipeline") pipeline = std::max<size_t>(1, std::stoul(value));
+            else if (arg == "--length") options.length = std::max(1, std::stoi(value));
+            else if (arg == "--depth") options.depth = std::stoi(value);
+            else if (arg == "--seed") options.seed = std::stoull(value);
+            else {
+                printUsage(argv[0]);
+                return 1;
+            }
+        }
+        if (socketPath.empty()) {
+            printUsage(argv[0]);
+            return 1;
+        }
+
+        // Each client gets its own workload: variable definitions first, then expressions
+        options.expressions = requests;
+        std::vector<std::vector<std::string>> workloads(clients);
+        for (size_t c = 0; c < clients; c++) {
+            WorkloadOptions clientOptions = options;
+            clientOptions.seed = options.seed + c;
+            std::string text = WorkloadGenerator(clientOptions).calculatorInput();
+            std::string_view line;
+            size_t pos = 0;
+            while (TextUtils::nextLine(text, pos, line)) workloads[c].emplace_back(line);
+        }
+
+        std::vector<ClientResult> results(clients);
+        std::vector<std::thread> threads;
+        Clock::time_point start = Clock::now();
+        for (size_t c = 0; c < clients; c++) {
+            threads.emplace_back([&, c] { results[c] = runClient(socketPath, workloads[c], pipeline); });
+        }
+        for (auto& thread : threads) thread.join();
+        double seconds = std::chrono::duration<double>(Clock::now() - start).count();
+
+        std::vector<double> latencies;
+        size_t errors = 0;
+        for (const auto& result : results) {
+            if (!result.failure.empty()) throw std::runtime_error(result.failure);
+            latencies.insert(latencies.end(), result.latenciesUs.begin(), result.latenciesUs.end());
+            errors += result.errors;
+        }
+        std::sort(latencies.begin(), latencies.end());
+
+        char report[512];
+        snprintf(report, sizeof(report),
+                 "{\"clients\": %zu, \"pipeline\": %zu, \"requests\": %zu, \"errors\": %zu, "
+                 "\"seconds\": %.3f, \"requests_per_s\": %.0f, "
+                 "\"p50_us\": %.1f, \"p99_us\": %.1f, \"max_us\": %.1f}\n",
+                 clients, pipeline, latencies.size(), errors, seconds,
+                 seconds > 0 ? latencies.size() / seconds : 0.0,
+                 percentile(latencies, 0.50), percentile(latencies, 0.99),
+                 latencies.empty() ? 0.0 : latencies.back());
+        std::cout << report;
+        return 0;
+    } catch (const std::exception& e) {
+        std::cerr << "Error: " << e.what() << std::endl;
+        return 1;
+    }
+}
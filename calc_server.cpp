@@ -0,0 +1,300 @@
+#include <cerrno>
+#include <csignal>
+#include <cstring>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <fcntl.h>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+#include "include/server_session.h"
+
+// Read size per read() call
+const size_t READ_CHUNK = 64 * 1024;
+
+// A connection whose client is not reading its responses stops being read from
+// once this much output is waiting
+const size_t MAX_PENDING_OUTPUT = 1 << 20;
+
+// Cleared by --no-jit; applies to every session
+bool jitEnabled = true;
+
+// Set on SIGINT/SIGTERM; the event loop then returns so the socket file is removed
+volatile std::sig_atomic_t stopRequested = 0;
+
+struct Connection {
+    int fd = -1;
+    ServerSession session;  // one evaluator per connection
+    std::string input;      // received text not yet ending in '\n'
+    std::string output;     // responses not yet sent
+    bool eof = false;       // client finished sending
+    unsigned events = 0;    // epoll interest currently registered
+};
+
+void printUsage(const char* programName) {
+    std::cerr << "Usage: " << programName << " [--socket PATH] [--no-jit]" << std::endl;
+    std::cerr << "  Reads newline-delimited expressions and answers each non-empty line with one line:" << std::endl;
+    std::cerr << "  its value, or \"Error: <message>\". A \"----\" line starts a new session (clears variables)." << std::endl;
+    std::cerr << "  Without --socket, requests come from stdin and responses go to stdout." << std::endl;
+    std::cerr << "  A line longer than " << ServerSession::MAX_LINE_LENGTH << " bytes is answered with an error and skipped." << std::endl;
+    std::cerr << "  --socket PATH  listen on a Unix domain socket; every connection has its own variables" << std::endl;
+    std::cerr << "  --no-jit       always interpret compiled programs, never translate them to native code" << std::endl;
+}
+
+void throwSystemError(const std::string& what) {
+    throw std::runtime_error(what + ": " + std::strerror(errno));
+}
+
+// Write all of text to a blocking descriptor
+void writeAll(int fd, const std::string& text) {
+    size_t done = 0;
+    while (done < text.size()) {
+        ssize_t n = ::write(fd, text.data() + done, text.size() - done);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            throwSystemError("write");
+        }
+        done += static_cast<size_t>(n);
+    }
+}
+
+// stdin/stdout mode: responses for everything received are written before blocking
+// on the next read, so a client can pipeline requests through a pair of pipes
+int serveStdio() {
+    ServerSession session;
+    session.setJitEnabled(jitEnabled);
+    std::string input;
+    std::string output;
+    char chunk[READ_CHUNK];
+    while (true) {
+        ssize_t n = ::read(STDIN_FILENO, chunk, sizeof(chunk));
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            throwSystemError("read");
+        }
+        if (n == 0) break;
+        input.append(chunk, static_cast<size_t>(n));
+        session.consume(input, output);
+        writeAll(STDOUT_FILENO, output);
+        output.clear();
+    }
+    // A last line without '\n'
+    session.finish(input, output);
+    writeAll(STDOUT_FILENO, output);
+    return 0;
+}
+
+class SocketServer {
+public:
+    explicit SocketServer(const std::string& path) : path(path) {}
+
+    ~SocketServer() {
+        for (auto& entry : connections) ::close(entry.first);
+        if (listenFd >= 0) {
+            ::close(listenFd);
+            ::unlink(path.c_str());
+        }
+        if (epollFd >= 0) ::close(epollFd);
+    }
+
+    void run() {
+        listen();
+        epoll_event events[64];
+        while (!stopRequested) {
+            int count = epoll_wait(epollFd, events, 64, -1);
+            if (count < 0) {
+                if (errno == EINTR) continue;
+                throwSystemError("epoll_wait");
+            }
+            for (int i = 0; i < count; i++) {
+                if (events[i].data.fd == listenFd) {
+                    acceptClients();
+                    continue;
+                }
+                auto it = connections.find(events[i].data.fd);
+                if (it == connections.end()) continue;
+                handle(*it->second, events[i].events);
+            }
+        }
+    }
+
+private:
+    void listen() {
+        sockaddr_un address{};
+        address.sun_family = AF_UNIX;
+        if (path.size() >= sizeof(address.sun_path)) {
+            throw std::runtime_error("Socket path too long: " + path);
+        }
+        std::memcpy(address.sun_path, path.c_str(), path.size() + 1);
+
+        // Replace a stale socket left by an earlier run, but never any other kind of file
+        struct stat info;
+        if (::stat(path.c_str(), &info) == 0) {
+            if (!S_ISSOCK(info.st_mode)) throw std::runtime_error("Not a socket: " + path);
+            ::unlink(path.c_str());
+        }
+
+        listenFd = ::socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+        if (listenFd < 0) throwSystemError("socket");
+        if (::bind(listenFd, reinterpret_cast<sockaddr*>(&address), sizeof(address)) < 0) {
+            int error = errno;
+            ::close(listenFd);
+            listenFd = -1;
+            errno = error;
+            throwSystemError("bind " + path);
+        }
+        if (::listen(listenFd, SOMAXCONN) < 0) throwSystemError("listen");
+
+        epollFd = epoll_create1(EPOLL_CLOEXEC);
+        if (epollFd < 0) throwSystemError("epoll_create1");
+        epoll_event event{};
+        event.events = EPOLLIN;
+        event.data.fd = listenFd;
+        if (epoll_ctl(epollFd, EPOLL_CTL_ADD, listenFd, &event) < 0) throwSystemError("epoll_ctl");
+    }
+
+    void acceptClients() {
+        while (true) {
+            int fd = ::accept4(listenFd, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC);
+            if (fd < 0) {
+                if (errno == EINTR || errno == ECONNABORTED) continue;
+                if (errno == EAGAIN || errno == EWOULDBLOCK) return;
+                // Out of descriptors and the like: drop this round, keep serving
+                std::cerr << "accept: " << std::strerror(errno) << std::endl;
+                return;
+            }
+            auto connection = std::make_unique<Connection>();
+            connection->fd = fd;
+            connection->session.setJitEnabled(jitEnabled);
+            connection->events = EPOLLIN;
+            epoll_event event{};
+            event.events = EPOLLIN;
+            event.data.fd = fd;
+            if (epoll_ctl(epollFd, EPOLL_CTL_ADD, fd, &event) < 0) {
+                ::close(fd);
+                continue;
+            }
+            connections.emplace(fd, std::move(connection));
+        }
+    }
+
+    void handle(Connection& connection, unsigned events) {
+        if (events & (EPOLLIN | EPOLLHUP | EPOLLERR)) {
+            if (!receive(connection)) {
+                close(connection);
+                return;
+            }
+        }
+        if (!send(connection)) {
+            close(connection);
+            return;
+        }
+        if (connection.eof && connection.output.empty()) {
+            close(connection);
+            return;
+        }
+        updateInterest(connection);
+    }
+
+    // Read what is available and answer every complete line; false on a broken connection
+    bool receive(Connection& connection) {
+        char chunk[READ_CHUNK];
+        while (!connection.eof && connection.output.size() < MAX_PENDING_OUTPUT) {
+            ssize_t n = ::read(connection.fd, chunk, sizeof(chunk));
+            if (n < 0) {
+                if (errno == EINTR) continue;
+                if (errno == EAGAIN || errno == EWOULDBLOCK) return true;
+                return false;
+            }
+            if (n == 0) {
+                connection.eof = true;
+                connection.session.finish(connection.input, connection.output);
+                return true;
+            }
+            connection.input.append(chunk, static_cast<size_t>(n));
+            connection.session.consume(connection.input, connection.output);
+        }
+        return true;
+    }
+
+    // Send as much pending output as the socket takes, then drop what was sent, so
+    // output only ever holds unsent responses; false on a broken connection
+    bool send(Connection& connection) {
+        std::string& output = connection.output;
+        size_t sent = 0;
+        bool ok = true;
+        while (sent < output.size()) {
+            ssize_t n = ::send(connection.fd, output.data() + sent, output.size() - sent, MSG_NOSIGNAL);
+            if (n < 0) {
+                if (errno == EINTR) continue;
+                ok = errno == EAGAIN || errno == EWOULDBLOCK;
+                break;
+            }
+            sent += static_cast<size_t>(n);
+        }
+        output.erase(0, sent);
+        return ok;
+    }
+
+    // Read while the client's responses are not piling up; wait for writability while they are pending
+    void updateInterest(Connection& connection) {
+        size_t pending = connection.output.size();
+        unsigned events = 0;
+        if (!connection.eof && pending < MAX_PENDING_OUTPUT) events |= EPOLLIN;
+        if (pending > 0) events |= EPOLLOUT;
+        if (events == connection.events) return;
+        epoll_event event{};
+        event.events = events;
+        event.data.fd = connection.fd;
+        epoll_ctl(epollFd, EPOLL_CTL_MOD, connection.fd, &event);
+        connection.events = events;
+    }
+
+    void close(Connection& connection) {
+        int fd = connection.fd;
+        epoll_ctl(epollFd, EPOLL_CTL_DEL, fd, nullptr);
+        ::close(fd);
+        connections.erase(fd);
+    }
+
+    std::string path;
+    int listenFd = -1;
+    int epollFd = -1;
+    std::unordered_map<int, std::unique_ptr<Connection>> connections;
+};
+
+int main(int argc, char* argv[]) {
+    try {
+        std::string socketPath;
+        for (int i = 1; i < argc; i++) {
+            std::string arg = argv[i];
+            if (arg == "--socket" && i + 1 < argc) {
+                socketPath = argv[++i];
+            } else if (arg == "--no-jit") {
+                jitEnabled = false;
+            } else {
+                printUsage(argv[0]);
+                return 1;
+            }
+        }
+
+        if (socketPath.empty()) return serveStdio();
+
+        struct sigaction action{};
+        action.sa_handler = [](int) { stopRequested = 1; };
+        sigaction(SIGINT, &action, nullptr);
+        sigaction(SIGTERM, &action, nullptr);
+
+        SocketServer server(socketPath);
+        std::cerr << "Listening on " << socketPath << std::endl;
+        server.run();
+        return 0;
+    } catch (const std::exception& e) {
+        std::cerr << "Error: " << e.what() << std::endl;
+        return 1;
+    }
+}
@@ -2,26 +2,116 @@
 #define PARSER_H
 
 #include <string>
+#include <string_view>
 #include <unordered_map>
+#include <vector>
+#include "compiled_expr.h"
+#include "function_table.h"
+#include "symbol_table.h"
 
 class Parser {
 public:
     Parser();
     
-    double parseStatement(const std::string& expr, size_t& pos);
-    double parseExpression(const std::string& expr, size_t& pos);
-    double parseTerm(const std::string& expr, size_t& pos);
-    double parsePower(const std::string& expr, size_t& pos);
-    double parseFactor(const std::string& expr, size_t& pos);
-    double parseNumber(const std::string& expr, size_t& pos);
+    // Compile a full statement into a stack-machine program
+    CompiledExpr compile(std::string_view expr);
+
+    // Same, reusing the storage of an existing program (no allocation once it has grown).
+    // If parsing fails, out.features still holds the features seen before the error.
+    void compile(std::string_view expr, CompiledExpr& out);
+
+    void parseStatement(std::string_view expr, size_t& pos, CompiledExpr& out);
+    void parseExpression(std::string_view expr, size_t& pos, CompiledExpr& out);
+    double parseNumber(std::string_view expr, size_t& pos, unsigned& features);
     
-    // Getter for variables
-    std::unordered_map<std::string, double>& getVariables() {
-        return variables;
+    // Snapshot of all defined variables by name (compatibility view of the slot storage)
+    std::unordered_map<std::string, double> getVariables() const {
+        std::unordered_map<std::string, double> view;
+        for (size_t slot = 0; slot < symbols.size(); slot++) {
+            if (variables.defined[slot]) view[symbols.name(slot)] = variables.values[slot];
+        }
+        return view;
     }
 
+    // Define or overwrite a variable by name
+    void setVariable(std::string_view name, double value) {
+        int slot = symbols.intern(name);
+        variables.reserveSlots(symbols.size());
+        variables.set(slot, value);
+    }
+
+    // Forget all variables, names and defined functions without releasing their storage
+    void reset() {
+        symbols.clear();
+        variables.clear();
+        functionNames.clear();
+    }
+
+    // Forget all variables and names but keep the defined functions: the names their
+    // bodies read are interned again, from slot 0, and the bodies renumbered to match
+    void resetVariables();
+
+    // Instructions a program may grow to by inlining defined functions
+    static constexpr size_t MAX_INLINED_CODE = 1 << 16;
+
+    // sin/cos implementation that calls compile to from now on (EXACT by default)
+    void setTrigAccuracy(TrigAccuracy accuracy) { trigAccuracy = accuracy; }
+    TrigAccuracy getTrigAccuracy() const { return trigAccuracy; }
+
+    // Intern a variable name and make sure the environment has a slot for it
+    int slotFor(std::string_view name);
+
+    SymbolTable& getSymbols() { return symbols; }
+    const SymbolTable& getSymbols() const { return symbols; }
+    Environment& getEnvironment() { return variables; }
+
 private:
-    std::unordered_map<std::string, double> variables;  // store variable values
+    // Append an instruction and track the operand stack depth it leaves behind
+    void emit(CompiledExpr& out, OpCode op, int stackEffect, int arg = 0, double value = 0.0);
+
+    // Emit a call once its arguments' code has been emitted: a built-in function's
+    // opcode, or the inlined body of a defined function
+    void emitCall(std::string_view name, int arguments, size_t firstArgument, CompiledExpr& out);
+
+    // "name(parameters) = expression" starting at start, with pos just past the '(';
+    // false (pos unspecified) if the statement is not a definition
+    bool parseDefinition(std::string_view expr, size_t start, size_t& pos, CompiledExpr& out);
+
+    // Slot argument of a LOAD_VAR that reads parameter i in a function body
+    static int parameterSlot(size_t i) { return -1 - static_cast<int>(i); }
+
+    // Function defined in the current session. Its body is compiled once; parameter i
+    // is read with LOAD_VAR parameterSlot(i), and each call copies the body with the
+    // argument's code in place of those reads, so calls cost what the expanded formula does.
+    struct DefinedFunction {
+        size_t arity = 0;
+        std::vector<Instruction> body;
+        unsigned features = 0;  // ExprFeature bits of the body
+        std::vector<size_t> unusedParameters;  // parameters the body never reads
+    };
+
+    // Operator, sign or open group waiting for its operands (see parseExpression)
+    struct Pending {
+        enum Kind { BINARY, NEGATE, GROUP, CALL };
+        Kind kind;
+        OpCode op = OpCode::ADD;  // BINARY: the operator
+        size_t nameStart = 0;     // CALL: function name within the expression
+        size_t nameLength = 0;
+        int arguments = 1;        // CALL: arguments parsed so far, counting the current one
+        size_t firstArgument = 0; // CALL: index of the first argument in argumentStarts
+    };
+
+    SymbolTable symbols;    // variable name -> slot
+    Environment variables;  // store variable values, indexed by slot
+    TrigAccuracy trigAccuracy = TrigAccuracy::EXACT;
+    size_t depth = 0;  // operand stack depth while compiling
+    std::vector<Pending> pending;  // parseExpression's explicit stack, reused across calls
+    std::vector<size_t> argumentStarts;  // code position of each argument of the open calls
+    SymbolTable functionNames;                // defined function name -> index into functions
+    std::vector<DefinedFunction> functions;   // entries past functionNames.size() are stale
+    std::vector<std::string_view> parameters; // of the definition being parsed
+    std::string_view defining;                // name of the definition being parsed
+    std::vector<Instruction> argumentCode;    // scratch for inlining
 };
 
 #endif // PARSER_H
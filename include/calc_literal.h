@@ -0,0 +1,430 @@
+#ifndef CALC_LITERAL_H
+#define CALC_LITERAL_H
+
+#include <cmath>
+#include <cstddef>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <type_traits>
+#include "function_table.h"
+
+// Compile-time version of the Parser grammar, for formulas fixed in the source code:
+//
+//     using namespace CalcLiterals;
+//     constexpr auto ratio = "(p + q) * r / (p - q)"_calc;
+//     double v = ratio(1.0, 2.0, 3.0);  // p, q, r in order of first appearance
+//
+// The literal is parsed by the compiler, and a syntax error in it fails the build.
+// The result is a type whose call operator is the formula written out as C++, so there
+// is no parsing or interpreting left at run time and the whole formula can be inlined.
+//
+// Differences from the runtime Parser: assignments are rejected (a literal has no
+// variables of its own to store into), and so is trailing input that Parser ignores.
+// Decimal literals with more than 15 significant digits or exponents beyond 1e22 are
+// converted without correct rounding and may differ in the last bit. Functions are
+// those of FunctionTable, and sin and cos are always libm's (TrigAccuracy::EXACT).
+
+namespace ConstexprCalc {
+
+enum class NodeKind { NUMBER, VARIABLE, ADD, SUB, MUL, DIV, POW, NEG, SIN, COS, SQRT, EXP, LOG, MIN, MAX, ATAN2 };
+
+struct Node {
+    NodeKind kind = NodeKind::NUMBER;
+    int lhs = -1;
+    int rhs = -1;
+    int var = -1;  // position of the variable in the call arguments
+    double value = 0.0;
+};
+
+// Expression tree of one literal. Every node consumes at least one character of the
+// source, so N = length + 1 nodes (and variables) are always enough.
+template <size_t N>
+struct Program {
+    Node nodes[N] = {};
+    int nodeCount = 0;
+    int root = -1;
+    size_t varStart[N] = {};
+    size_t varLength[N] = {};
+    int varCount = 0;
+};
+
+template <size_t N>
+class ConstexprParser {
+public:
+    static constexpr Program<N> parse(std::string_view text) {
+        ConstexprParser parser(text);
+        parser.parseStatement();
+        return parser.program;
+    }
+
+private:
+    constexpr explicit ConstexprParser(std::string_view text) : text(text) {}
+
+    static constexpr bool isSpace(char c) {
+        return c == ' ' || c == '\t' || c == '\n' || c == '\v' || c == '\f' || c == '\r';
+    }
+    static constexpr bool isDigit(char c) { return c >= '0' && c <= '9'; }
+    static constexpr bool isAlpha(char c) { return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z'); }
+    static constexpr bool isAlnum(char c) { return isAlpha(c) || isDigit(c); }
+    static constexpr int digitValue(char c) {
+        if (isDigit(c)) return c - '0';
+        if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+        if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+        return 16;
+    }
+
+    constexpr void skipSpace() {
+        while (pos < text.size() && isSpace(text[pos])) ++pos;
+    }
+
+    constexpr int add(NodeKind kind, int lhs = -1, int rhs = -1, double value = 0.0, int var = -1) {
+        Node& node = program.nodes[program.nodeCount];
+        node.kind = kind;
+        node.lhs = lhs;
+        node.rhs = rhs;
+        node.value = value;
+        node.var = var;
+        return program.nodeCount++;
+    }
+
+    static constexpr NodeKind kindOf(OpCode op) {
+        switch (op) {
+            case OpCode::POW: return NodeKind::POW;
+            case OpCode::SIN: return NodeKind::SIN;
+            case OpCode::COS: return NodeKind::COS;
+            case OpCode::SQRT: return NodeKind::SQRT;
+            case OpCode::EXP: return NodeKind::EXP;
+            case OpCode::LOG: return NodeKind::LOG;
+            case OpCode::MIN: return NodeKind::MIN;
+            case OpCode::MAX: return NodeKind::MAX;
+            default: return NodeKind::ATAN2;
+        }
+    }
+
+    // Position of a variable among the call arguments, assigned on first appearance
+    constexpr int variableFor(size_t start, size_t length) {
+        std::string_view name = text.substr(start, length);
+        for (int i = 0; i < program.varCount; i++) {
+            if (text.substr(program.varStart[i], program.varLength[i]) == name) return i;
+        }
+        program.varStart[program.varCount] = start;
+        program.varLength[program.varCount] = length;
+        return program.varCount++;
+    }
+
+    // Statement := Expression  (no assignment, no trailing input)
+    constexpr void parseStatement() {
+        skipSpace();
+        if (pos < text.size() && isAlpha(text[pos])) {
+            size_t start = pos;
+            while (pos < text.size() && (isAlnum(text[pos]) || text[pos] == '_')) ++pos;
+            skipSpace();
+            if (pos < text.size() && text[pos] == '=')
+                throw std::runtime_error("Assignments are not supported in _calc literals");
+            pos = start;
+        }
+
+        program.root = parseExpression();
+        skipSpace();
+        if (pos < text.size()) throw std::runtime_error("Unexpected input after expression");
+    }
+
+    // Expression := Term { ('+' | '-') Term }
+    constexpr int parseExpression() {
+        int lhs = parseTerm();
+        while (true) {
+            skipSpace();
+            if (pos >= text.size()) break;
+            char op = text[pos];
+            if (op != '+' && op != '-') break;
+            ++pos;
+            int rhs = parseTerm();
+            lhs = add(op == '+' ? NodeKind::ADD : NodeKind::SUB, lhs, rhs);
+        }
+        return lhs;
+    }
+
+    // Term := Power { ('*' | '/') Power }
+    constexpr int parseTerm() {
+        int lhs = parsePower();
+        while (true) {
+            skipSpace();
+            if (pos >= text.size()) break;
+            char op = text[pos];
+            if (op != '*' && op != '/') break;
+            ++pos;
+            int rhs = parsePower();
+            lhs = add(op == '*' ? NodeKind::MUL : NodeKind::DIV, lhs, rhs);
+        }
+        return lhs;
+    }
+
+    // Power := Factor [ '^' Power ]  (RIGHT-ASSOCIATIVE)
+    constexpr int parsePower() {
+        int base = parseFactor();
+        skipSpace();
+        if (pos >= text.size() || text[pos] != '^') return base;
+        ++pos;
+        int exponent = parsePower();
+        return add(NodeKind::POW, base, exponent);
+    }
+
+    // Factor := Number | '(' Expression ')' | Function | Variable | Unary +/-
+    constexpr int parseFactor() {
+        skipSpace();
+        if (pos >= text.size()) throw std::runtime_error("Unexpected end of expression");
+
+        if (text[pos] == '+') { ++pos; return parseFactor(); }
+        if (text[pos] == '-') { ++pos; return add(NodeKind::NEG, parseFactor()); }
+
+        // Function or variable
+        if (isAlpha(text[pos])) {
+            size_t start = pos;
+            while (pos < text.size() && (isAlnum(text[pos]) || text[pos] == '_')) ++pos;
+            size_t length = pos - start;
+            std::string_view name = text.substr(start, length);
+
+            skipSpace();
+            if (pos < text.size() && text[pos] == '(') {
+                ++pos;
+                int arguments[2] = {parseExpression(), -1};
+                int count = 1;
+                while (pos < text.size() && text[pos] == ',' && count < 2) {
+                    ++pos;
+                    arguments[count++] = parseExpression();
+                }
+                if (pos >= text.size() || text[pos] != ')')
+                    throw std::runtime_error("Missing ')' in function call");
+                ++pos;
+
+                const FunctionTable::Function* function = FunctionTable::find(name);
+                if (!function) throw std::runtime_error("Unknown function: " + std::string(name));
+                if (count != function->arity) throw std::runtime_error("Wrong number of function arguments");
+                return add(kindOf(function->op), arguments[0], arguments[1]);
+            }
+
+            return add(NodeKind::VARIABLE, -1, -1, 0.0, variableFor(start, length));
+        }
+
+        // Parentheses
+        if (text[pos] == '(') {
+            ++pos;
+            int inner = parseExpression();
+            if (pos >= text.size() || text[pos] != ')')
+                throw std::runtime_error("Missing ')'");
+            ++pos;
+            return inner;
+        }
+
+        return add(NodeKind::NUMBER, -1, -1, parseNumber());
+    }
+
+    // Parse numbers in binary (b), hex (0x), or decimal
+    constexpr double parseNumber() {
+        size_t start = pos;
+        // Hex
+        if (text[pos] == '0' && pos + 1 < text.size() && (text[pos + 1] == 'x' || text[pos + 1] == 'X')) {
+            pos += 2;
+            size_t hexStart = pos;
+            while (pos < text.size() && digitValue(text[pos]) < 16) ++pos;
+            return convertInteger(hexStart, pos, 16);
+        }
+
+        // Binary (ends with 'b')
+        while (pos < text.size() && (text[pos] == '0' || text[pos] == '1')) ++pos;
+        if (pos < text.size() && (text[pos] == 'b' || text[pos] == 'B')) {
+            double value = convertInteger(start, pos, 2);
+            ++pos;
+            return value;
+        }
+
+        // Decimal: consume every digit and '.', converting the longest valid prefix
+        pos = start;
+        while (pos < text.size() && (isDigit(text[pos]) || text[pos] == '.')) ++pos;
+        return convertDecimal(start, pos);
+    }
+
+    constexpr double convertInteger(size_t start, size_t end, unsigned base) const {
+        if (start == end) throw std::runtime_error("Invalid number");
+        unsigned long long value = 0;
+        for (size_t i = start; i < end; i++) {
+            unsigned digit = static_cast<unsigned>(digitValue(text[i]));
+            if (value > (~0ULL - digit) / base) throw std::runtime_error("Number out of range");
+            value = value * base + digit;
+        }
+        return static_cast<double>(value);
+    }
+
+    // digits [ '.' digits ], at least one digit. Up to 19 significant digits are kept
+    // exactly; a mantissa below 2^53 scaled by an exact power of ten (up to 1e22) gives
+    // the correctly rounded result, the same as the runtime conversion.
+    constexpr double convertDecimal(size_t start, size_t end) const {
+        unsigned long long mantissa = 0;
+        int significant = 0;
+        int exponent = 0;
+        bool anyDigit = false;
+        bool fraction = false;
+        for (size_t i = start; i < end; i++) {
+            char c = text[i];
+            if (c == '.') {
+                if (fraction) break;
+                fraction = true;
+                continue;
+            }
+            anyDigit = true;
+            int digit = c - '0';
+            if (mantissa == 0 && digit == 0) {
+                if (fraction) --exponent;
+            } else if (significant < 19) {
+                mantissa = mantissa * 10 + static_cast<unsigned long long>(digit);
+                ++significant;
+                if (fraction) --exponent;
+            } else if (!fraction) {
+                ++exponent;
+            }
+        }
+        if (!anyDigit) throw std::runtime_error("Invalid number");
+        if (mantissa == 0) return 0.0;
+
+        double value = static_cast<double>(mantissa);
+        if (mantissa <= (1ULL << 53) && exponent >= -22 && exponent <= 22) {
+            return exponent < 0 ? value / powerOfTen(-exponent) : value * powerOfTen(exponent);
+        }
+        for (; exponent > 0; --exponent) value *= 10.0;
+        for (; exponent < 0; ++exponent) value /= 10.0;
+        if (value == 0.0 || value - value != 0.0) throw std::runtime_error("Number out of range");
+        return value;
+    }
+
+    // Exact for exponent <= 22
+    static constexpr double powerOfTen(int exponent) {
+        double value = 1.0;
+        for (int i = 0; i < exponent; i++) value *= 10.0;
+        return value;
+    }
+
+    std::string_view text;
+    size_t pos = 0;
+    Program<N> program;
+};
+
+// The callable produced by a _calc literal; Source::text is the formula
+template <typename Source>
+class CalcFormula {
+public:
+    static constexpr std::string_view text = Source::text;
+    static constexpr Program<Source::text.size() + 1> program =
+        ConstexprParser<Source::text.size() + 1>::parse(Source::text);
+
+    // Number of variables, i.e. of call arguments
+    static constexpr size_t arity = static_cast<size_t>(program.varCount);
+
+    // Name of the variable taken at the given argument position
+    static constexpr std::string_view variable(size_t position) {
+        return text.substr(program.varStart[position], program.varLength[position]);
+    }
+
+    template <typename... Args>
+    constexpr double operator()(Args... args) const {
+        static_assert(sizeof...(Args) == arity, "_calc formula called with the wrong number of variables");
+        const double values[sizeof...(Args) + 1] = {static_cast<double>(args)..., 0.0};
+        return evaluate<program.root>(values);
+    }
+
+private:
+    // libm's pow, as Evaluator calls it. With a constant exponent of 2 the compiler
+    // would otherwise emit x * x, which is not always pow's result.
+    static double pow(double x, double y) {
+        volatile double exponent = y;
+        return std::pow(x, exponent);
+    }
+
+    // One instantiation per tree node; the call operator compiles to straight-line code
+    template <int I>
+    static constexpr double evaluate(const double* values) {
+        constexpr Node node = program.nodes[I];
+        if constexpr (node.kind == NodeKind::NUMBER) return node.value;
+        else if constexpr (node.kind == NodeKind::VARIABLE) return values[node.var];
+        else if constexpr (node.kind == NodeKind::ADD) return evaluate<node.lhs>(values) + evaluate<node.rhs>(values);
+        else if constexpr (node.kind == NodeKind::SUB) return evaluate<node.lhs>(values) - evaluate<node.rhs>(values);
+        else if constexpr (node.kind == NodeKind::MUL) return evaluate<node.lhs>(values) * evaluate<node.rhs>(values);
+        else if constexpr (node.kind == NodeKind::DIV) return evaluate<node.lhs>(values) / evaluate<node.rhs>(values);
+        else if constexpr (node.kind == NodeKind::POW) return pow(evaluate<node.lhs>(values), evaluate<node.rhs>(values));
+        else if constexpr (node.kind == NodeKind::NEG) return -evaluate<node.lhs>(values);
+        else if constexpr (node.kind == NodeKind::SIN) return std::sin(evaluate<node.lhs>(values));
+        else if constexpr (node.kind == NodeKind::COS) return std::cos(evaluate<node.lhs>(values));
+        else if constexpr (node.kind == NodeKind::SQRT) return std::sqrt(evaluate<node.lhs>(values));
+        else if constexpr (node.kind == NodeKind::EXP) return std::exp(evaluate<node.lhs>(values));
+        else if constexpr (node.kind == NodeKind::LOG) return std::log(evaluate<node.lhs>(values));
+        else if constexpr (node.kind == NodeKind::MIN) return FunctionTable::min(evaluate<node.lhs>(values), evaluate<node.rhs>(values));
+        else if constexpr (node.kind == NodeKind::MAX) return FunctionTable::max(evaluate<node.lhs>(values), evaluate<node.rhs>(values));
+        else return std::atan2(evaluate<node.lhs>(values), evaluate<node.rhs>(values));
+    }
+};
+
+#if defined(__cpp_nontype_template_args) && __cpp_nontype_template_args >= 201911L
+
+// C++20: the literal text is a class-type template argument
+template <size_t N>
+struct FixedString {
+    char chars[N] = {};
+    constexpr FixedString(const char (&literal)[N]) {
+        for (size_t i = 0; i < N; i++) chars[i] = literal[i];
+    }
+};
+
+template <FixedString S>
+struct LiteralSource {
+    static constexpr std::string_view text{S.chars, sizeof(S.chars) - 1};
+};
+
+#else
+
+// C++17: the literal text arrives as a character pack (GNU extension, GCC and Clang)
+template <char... Chars>
+struct LiteralSource {
+    static constexpr char chars[] = {Chars..., '\0'};
+    static constexpr std::string_view text{chars, sizeof...(Chars)};
+};
+
+#endif
+
+} // namespace ConstexprCalc
+
+namespace CalcLiterals {
+
+#if defined(__cpp_nontype_template_args) && __cpp_nontype_template_args >= 201911L
+
+template <ConstexprCalc::FixedString S>
+constexpr auto operator""_calc() {
+    return ConstexprCalc::CalcFormula<ConstexprCalc::LiteralSource<S>>{};
+}
+
+#else
+
+#if defined(__clang__)
+#pragma clang diagnostic push
+#pragma clang diagnostic ignored "-Wgnu-string-literal-operator-template"
+#elif defined(__GNUC__)
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wpedantic"
+#endif
+
+template <typename CharT, CharT... Chars>
+constexpr auto operator""_calc() {
+    static_assert(std::is_same_v<CharT, char>, "_calc literals must be narrow strings");
+    return ConstexprCalc::CalcFormula<ConstexprCalc::LiteralSource<Chars...>>{};
+}
+
+#if defined(__clang__)
+#pragma clang diagnostic pop
+#elif defined(__GNUC__)
+#pragma GCC diagnostic pop
+#endif
+
+#endif
+
+} // namespace CalcLiterals
+
+#endif // CALC_LITERAL_H
@@ -0,0 +1,85 @@
+#ifndef COMPILED_EXPR_H
+#define COMPILED_EXPR_H
+
+#include <memory>
+#include <vector>
+
+class JitCode;
+
+// Stack-machine instruction set produced by Parser and run by Evaluator
+enum class OpCode : unsigned char {
+    PUSH_CONST,   // push value
+    LOAD_VAR,     // push variable in slot arg
+    STORE_VAR,    // variable in slot arg = top (value stays on the stack)
+    ADD,
+    SUB,
+    MUL,
+    DIV,
+    POW,
+    NEG,
+    SIN,
+    COS,
+    SQRT,
+    EXP,
+    LOG,          // natural logarithm
+    MIN,          // FunctionTable::min of the two top values
+    MAX,          // FunctionTable::max
+    ATAN2,        // atan2(below top, top)
+    SIN_FAST,     // FastTrig::sin (TrigAccuracy::FAST)
+    COS_FAST,     // FastTrig::cos
+    DROP          // discard the top value (an unused function argument, read only to check it is defined)
+};
+
+// Syntactic features recorded while parsing, used to categorize expressions
+enum ExprFeature : unsigned {
+    FEATURE_ASSIGNMENT     = 1u << 0,  // statement of the form "name = expression"
+    FEATURE_VARIABLES      = 1u << 1,  // reads at least one variable
+    FEATURE_HEX_LITERAL    = 1u << 2,  // 0x... literal
+    FEATURE_BINARY_LITERAL = 1u << 3,  // ...b literal
+    FEATURE_FUNCTION_CALL  = 1u << 4,  // sin(...), pow(..., ...), ... (see FunctionTable)
+    FEATURE_POWER          = 1u << 5,  // '^' operator
+    FEATURE_PARENTHESES    = 1u << 6,  // parenthesized sub-expression
+    FEATURE_DEFINITION     = 1u << 7   // "name(parameters) = expression" (also FEATURE_ASSIGNMENT)
+};
+
+// Change in operand stack depth when op runs
+inline int stackEffect(OpCode op) {
+    switch (op) {
+        case OpCode::PUSH_CONST:
+        case OpCode::LOAD_VAR:
+            return 1;
+        case OpCode::ADD:
+        case OpCode::SUB:
+        case OpCode::MUL:
+        case OpCode::DIV:
+        case OpCode::POW:
+        case OpCode::MIN:
+        case OpCode::MAX:
+        case OpCode::ATAN2:
+        case OpCode::DROP:
+            return -1;
+        default:
+            return 0;
+    }
+}
+
+struct Instruction {
+    OpCode op;
+    int arg;        // SymbolTable slot for LOAD_VAR / STORE_VAR
+    double value;   // literal for PUSH_CONST
+};
+
+// An expression compiled once and executed any number of times.
+// Variable slots refer to the SymbolTable of the Parser that compiled it.
+struct CompiledExpr {
+    std::vector<Instruction> code;
+    size_t maxStack = 0;              // deepest operand stack the program needs
+    unsigned features = 0;            // ExprFeature bits seen while parsing
+
+    // Tiering state maintained by Evaluator::execute
+    mutable unsigned executions = 0;             // interpreted runs so far
+    mutable bool jitAttempted = false;           // native compilation already tried
+    mutable std::shared_ptr<const JitCode> jit;  // native code, once hot
+};
+
+#endif // COMPILED_EXPR_H
@@ -0,0 +1,72 @@
+#ifndef DEPENDENCY_GRAPH_H
+#define DEPENDENCY_GRAPH_H
+
+#include <string>
+#include <string_view>
+#include <vector>
+#include "compiled_expr.h"
+#include "evaluator.h"
+
+// Spreadsheet-style recomputation on top of an Evaluator's variables.
+// Each formula is compiled once, and the graph records which variables it reads and
+// which derived variable (if any) it defines. Changing a variable recomputes only the
+// formulas that depend on it, directly or through other derived variables, in
+// topological order. Definitions that would create a dependency cycle are rejected.
+//
+//   DependencyGraph sheet(evaluator);
+//   sheet.assign("pi", 3.14);
+//   size_t area = sheet.define("area = pi * radius ^ 2");
+//   size_t big  = sheet.define("area * 2");
+//   sheet.assign("radius", 6);   // recomputes area, then big
+class DependencyGraph {
+public:
+    explicit DependencyGraph(Evaluator& evaluator) : evaluator(evaluator) {}
+
+    // Add a formula and evaluate it. "name = expression" defines a derived variable;
+    // defining the same name again replaces its formula and keeps its id. Returns the
+    // formula's id. Throws if the statement does not parse or would create a dependency cycle.
+    size_t define(std::string_view statement);
+
+    // Set an input variable and recompute everything that depends on it. A formula that
+    // defined the variable is dropped, and its id is given to the next new formula.
+    // Returns the number of formulas recomputed.
+    size_t assign(std::string_view name, double value);
+
+    // Latest result of a formula; throws the formula's evaluation error if it failed
+    double value(size_t id) const;
+
+    bool hasError(size_t id) const { return !nodes[id].error.empty(); }
+    const std::string& error(size_t id) const { return nodes[id].error; }
+    const std::string& text(size_t id) const { return nodes[id].text; }
+    size_t size() const { return nodes.size(); }
+
+private:
+    struct Node {
+        std::string text;
+        CompiledExpr program;
+        std::vector<int> reads;  // distinct slots read by the program
+        int writes = -1;         // slot defined by the program, or -1
+        double value = 0.0;
+        std::string error;       // message of the last failed evaluation
+    };
+
+    void ensureSlots(size_t count);
+    void link(size_t id);
+    void unlink(size_t id);
+    void checkForCycle(const Node& node) const;
+    size_t recomputeFrom(int slot);
+    void evaluateNode(size_t id);
+
+    Evaluator& evaluator;
+    std::vector<Node> nodes;
+    std::vector<std::vector<size_t>> readersOf;  // slot -> formulas reading it
+    std::vector<long> writerOf;                  // slot -> formula defining it, or -1
+    std::vector<size_t> freeIds;                 // formulas dropped by assign(), reused by define()
+
+    // Scratch state reused by recomputeFrom()
+    std::vector<unsigned> pendingInputs;
+    std::vector<size_t> affected;
+    std::vector<size_t> ready;
+};
+
+#endif // DEPENDENCY_GRAPH_H
@@ -1,15 +1,130 @@
 #ifndef EVALUATOR_H
 #define EVALUATOR_H
 
+#include <ostream>
 #include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
 #include "Parser.h"
+#include "compiled_expr.h"
+#include "optimizer.h"
+#include "jit_compiler.h"
+#include "result_cache.h"
+
+// Variable columns for batch evaluation: name -> pointer to one value per row
+using ColumnMap = std::unordered_map<std::string, const double*>;
 
 class Evaluator {
 public:
-    double evaluate(const std::string& expression);
+    // Compile and run in one step. Results of expressions without assignments are
+    // remembered (see ResultCache), so repeating an expression whose variables have not
+    // changed since skips parsing and evaluation.
+    //
+    // "name(parameters) = expression" defines a function (the definition evaluates to 0).
+    // Its body is compiled once and inlined into every expression compiled afterwards
+    // that calls it; programs compiled earlier keep the definition they inlined.
+    double evaluate(std::string_view expression);
+
+    // Result cache controls: DEFAULT_CAPACITY entries by default, 0 turns it off
+    void setCacheCapacity(size_t entries) { cache.setCapacity(entries); }
+    const ResultCache& getCache() const { return cache; }
+
+    // ExprFeature bits of the last expression passed to evaluate(), including
+    // one that failed (then only the features parsed before the error)
+    unsigned lastFeatures() const { return scratch.features; }
+
+    // sin/cos implementation for expressions compiled from now on: libm (EXACT, the
+    // default) or the FastTrig polynomials. Changing it drops cached results.
+    void setTrigAccuracy(TrigAccuracy accuracy) {
+        if (accuracy == parser.getTrigAccuracy()) return;
+        parser.setTrigAccuracy(accuracy);
+        cache.clear();
+    }
+    TrigAccuracy getTrigAccuracy() const { return parser.getTrigAccuracy(); }
+
+    // Write each program's tree before and after optimization to a stream (nullptr = off)
+    void setOptimizationDump(std::ostream* stream) { optimizationDump = stream; }
+
+    // Parse once; the program can then be executed many times
+    CompiledExpr compile(std::string_view expression);
+
+    // Same, into an existing program. If parsing fails, out.features still holds
+    // the features seen before the error (as lastFeatures() does for evaluate()).
+    void compile(std::string_view expression, CompiledExpr& out);
+
+    // Run a compiled program against this evaluator's variables.
+    // A program executed more than the JIT threshold is translated to native code
+    // (Linux x86-64) and runs natively from then on. That code shares pages with this
+    // evaluator's other native code, so run such a program only on this evaluator's thread.
+    double execute(const CompiledExpr& program);
+
+    // Run a compiled program against an explicit variable environment (indexed by slot)
+    double execute(const CompiledExpr& program, Environment& env);
+
+    // JIT tier controls: enabled by default where supported
+    static constexpr unsigned DEFAULT_JIT_THRESHOLD = 1000;
+    void setJitEnabled(bool enabled) { jitEnabled = enabled && JitCompiler::isSupported(); }
+    bool isJitEnabled() const { return jitEnabled; }
+    void setJitThreshold(unsigned executions) { jitThreshold = executions; }
+
+    // Snapshot of defined variables by name
+    std::unordered_map<std::string, double> getVariables() const { return parser.getVariables(); }
+
+    // Variable names and the slots they were interned into
+    const SymbolTable& getSymbols() const { return parser.getSymbols(); }
+
+    // Slot of a variable name, interning it (undefined) on first use
+    int internVariable(std::string_view name) { return parser.slotFor(name); }
+
+    // Define or overwrite a variable without compiling an assignment
+    void setVariable(std::string_view name, double value) { parser.setVariable(name, value); }
+
+    // Return to the state of a new Evaluator (no variables, names or functions) while keeping
+    // every buffer, so reusing one evaluator for many sessions does not allocate.
+    // Programs compiled before the reset must not be executed after it.
+    void reset() {
+        parser.reset();
+        cache.clear();
+    }
+
+    // reset(), but defined functions stay callable (their free variables are read by name)
+    void resetVariables() {
+        parser.resetVariables();
+        cache.clear();
+    }
+
+    // Evaluate one program over `rows` rows of column data and write one result per row.
+    // Variables found in `columns` vary per row; any other variable is read from this
+    // evaluator. Results are bit-identical to calling execute() once per row.
+    void evaluateBatch(const CompiledExpr& program, const ColumnMap& columns,
+                       size_t rows, double* out);
 
 private:
+    double evaluateWithStats(std::string_view expression);
+
+    // evaluate() after a cache miss
+    double compileAndRun(std::string_view expression);
+
+    // Parse and optimize, dropping cached results when the program defines a function
+    void compileProgram(std::string_view expression, CompiledExpr& program);
+
+    // Run the optimizer on a freshly compiled program, dumping it if requested
+    void optimize(std::string_view expression, CompiledExpr& program);
+
+    // Bytecode interpreter
+    double interpret(const CompiledExpr& program, Environment& env);
+
     Parser parser;
+    Optimizer optimizer;
+    ResultCache cache;
+    std::ostream* optimizationDump = nullptr;
+    JitCompiler jit;                 // packs native code of this evaluator's hot programs
+    bool jitEnabled = JitCompiler::isSupported();
+    unsigned jitThreshold = DEFAULT_JIT_THRESHOLD;
+    CompiledExpr scratch;            // program reused by evaluate()
+    std::vector<double> stack;       // operand stack reused across executions
+    std::vector<double> batchStack;  // one block of rows per operand stack slot
 };
 
 #endif
@@ -3,10 +3,13 @@
 
 #include <vector>
 #include <string>
+#include <string_view>
 #include <stdexcept>
 #include "evaluator.h"
 #include "formatter.h"
 #include "categorizer.h"
+#include "session_binary.h"
+#include "stats.h"
 
 struct CategoryResults {
     std::vector<std::string> basicCalc;
@@ -21,40 +24,110 @@ public:
     static CategoryResults processExpressions(
         const std::vector<std::string>& expressions,
         Evaluator& evaluator) {
+        std::vector<std::string_view> views(expressions.begin(), expressions.end());
+        return processExpressions(views, evaluator);
+    }
+
+    // Same, for expressions that are views into a mapped input file
+    static CategoryResults processExpressions(
+        const std::vector<std::string_view>& expressions,
+        Evaluator& evaluator) {
         
         CategoryResults results;
+        std::string output;
+        Categorizer::Category cat;
         
         for (const auto& expression : expressions) {
-            try {
-                // Evaluate the expression (even if it's a variable assignment)
-                double result = evaluator.evaluate(expression);
-                
-                // Skip display of pure variable assignments (e.g., "x = 10")
-                // Only show variable usage (e.g., "x + y")
-                if (Categorizer::isVariableAssignment(expression)) {
-                    continue;
-                }
-                
-                // Format the result
-                bool hasDecimal = Formatter::hasDecimalPoint(expression);
-                std::string output = Formatter::formatResult(expression, result, hasDecimal);
-                
-                // Categorize and store
-                Categorizer::Category cat = Categorizer::categorize(expression);
+            if (processExpression(expression, evaluator, cat, output)) {
                 addToCategory(results, cat, output);
-                
-            } catch (const std::exception& e) {
-                // Handle errors
-                std::string errorOutput = expression + " => Error: " + e.what();
-                Categorizer::Category cat = Categorizer::categorize(expression);
-                addToCategory(results, cat, errorOutput);
             }
         }
         
         return results;
     }
 
+    // Same for a binary session file: every line except "----", in file order, with
+    // the names of each "----" block bound into the evaluator as the block starts.
+    // Variables carry over between blocks, as they do for text input.
+    static CategoryResults processBinary(const SessionBinary& binary, Evaluator& evaluator) {
+        CategoryResults results;
+        std::string output;
+        Categorizer::Category cat;
+        CompiledExpr program;
+        std::vector<int> slots;
+        uint32_t boundScope = 0;
+        bool bound = false;
+
+        for (size_t line = 0; line < binary.lineCount(); line++) {
+            if (binary.lineKind(line) == SessionBinaryFormat::SEPARATOR) continue;
+            if (!bound || binary.lineScope(line) != boundScope) {
+                boundScope = binary.lineScope(line);
+                binary.bindScope(boundScope, evaluator, slots);
+                bound = true;
+            }
+            bool shown = process(binary.lineText(line), cat, output,
+                                 [&] { return binary.run(line, evaluator, slots, program); },
+                                 [&] { return binary.lineFeatures(line); });
+            if (shown) addToCategory(results, cat, output);
+        }
+
+        return results;
+    }
+
+    // Evaluate, format and categorize a single expression.
+    // Returns false for pure variable assignments, which are evaluated but not displayed.
+    static bool processExpression(std::string_view expression,
+                                  Evaluator& evaluator,
+                                  Categorizer::Category& cat,
+                                  std::string& output) {
+        return process(expression, cat, output,
+                       [&] { return evaluator.evaluate(expression); },
+                       [&] { return evaluator.lastFeatures(); });
+    }
+
 private:
+    // Shared by text and binary input: evaluate() computes the value (or throws) and
+    // features() then gives the ExprFeature bits of the line
+    template <typename Evaluate, typename Features>
+    static bool process(std::string_view expression,
+                        Categorizer::Category& cat,
+                        std::string& output,
+                        Evaluate evaluate,
+                        Features features) {
+        uint64_t start = Stats::enabled() ? Stats::now() : 0;
+        try {
+            // Evaluate the expression (even if it's a variable assignment)
+            double result = evaluate();
+            
+            // Skip display of pure variable assignments (e.g., "x = 10")
+            // Only show variable usage (e.g., "x + y")
+            unsigned seen = features();
+            if (Categorizer::isVariableAssignment(seen)) {
+                return false;
+            }
+            
+            // Format the result into the caller's reused buffer
+            {
+                Stats::Timer timer(Stats::FORMAT);
+                bool hasDecimal = Formatter::hasDecimalPoint(expression);
+                output.clear();
+                Formatter::appendResult(output, expression, result, hasDecimal);
+            }
+            
+            // Categorize from what the parser saw; no rescan of the text
+            Stats::Timer timer(Stats::CATEGORIZE);
+            cat = Categorizer::categorize(seen);
+            
+        } catch (const std::exception& e) {
+            // Handle errors
+            Stats::recordError(e);
+            output = std::string(expression) + " => Error: " + e.what();
+            cat = Categorizer::categorize(features());
+        }
+        if (start) Stats::recordExpression(cat, Stats::now() - start);
+        return true;
+    }
+
     // Helper method to add result to appropriate category
     static void addToCategory(CategoryResults& results, 
                              Categorizer::Category cat,
@@ -1,47 +1,59 @@
 #ifndef FILE_READER_H
 #define FILE_READER_H
 
-#include <fstream>
 #include <vector>
 #include <string>
+#include <string_view>
 #include <stdexcept>
+#include "mapped_file.h"
+#include "stats.h"
+#include "text_utils.h"
 
 class FileReader {
 public:
-    // Read all expressions from input file
-    static std::vector<std::string> readExpressions(const std::string& filename) {
-        std::ifstream input(filename);
-        if (!input) {
+    // Map an input file, throwing if it cannot be opened
+    static MappedFile openInput(const std::string& filename) {
+        Stats::Timer timer(Stats::READ);
+        MappedFile file;
+        if (!file.open(filename)) {
             throw std::runtime_error("Error: could not open input file: " + filename);
         }
+        return file;
+    }
+
+    // Read all expressions from a mapped file as trimmed views into its contents
+    static std::vector<std::string_view> readExpressions(const MappedFile& file) {
+        Stats::Timer timer(Stats::READ);
+        std::string_view text = file.contents();
+        Stats::addBytes(Stats::READ, text.size());
+        std::vector<std::string_view> expressions;
+        std::string_view line;
+        size_t pos = 0;
         
-        std::vector<std::string> expressions;
-        std::string line;
-        
-        while (std::getline(input, line)) {
+        while (TextUtils::nextLine(text, pos, line)) {
             // Trim whitespace
-            line = trim(line);
+            line = TextUtils::trim(line);
             
             // Skip empty lines
             if (line.empty()) continue;
             
             // Skip session headers (----)
-            if (line == "----") continue;
+            if (TextUtils::isSessionSeparator(line)) continue;
             
             expressions.push_back(line);
         }
         
-        input.close();
         return expressions;
     }
-    
-private:
-    // Helper to trim whitespace
-    static std::string trim(const std::string& str) {
-        size_t first = str.find_first_not_of(" \t\r\n");
-        if (first == std::string::npos) return "";
-        size_t last = str.find_last_not_of(" \t\r\n");
-        return str.substr(first, (last - first + 1));
+
+    // Read all expressions from input file into owned strings
+    static std::vector<std::string> readExpressions(const std::string& filename) {
+        MappedFile file = openInput(filename);
+        std::vector<std::string> expressions;
+        for (std::string_view line : readExpressions(file)) {
+            expressions.emplace_back(line);
+        }
+        return expressions;
     }
 };
 
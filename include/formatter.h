@@ -2,32 +2,51 @@
 #define FORMATTER_H
 
 #include <string>
-#include <iomanip>
-#include <sstream>
+#include <string_view>
+#include <charconv>
+#include <cmath>
+#include <cstdio>
 
 class Formatter {
 public:
+    // Large enough for any formatted result, including fixed notation of 1e308
+    static constexpr size_t RESULT_BUFFER_SIZE = 512;
+
     // Format a result based on whether it's an integer or decimal
-    static std::string formatResult(const std::string& expression, double result, bool hasDecimal) {
+    static std::string formatResult(std::string_view expression, double result, bool hasDecimal) {
+        std::string output;
+        appendResult(output, expression, result, hasDecimal);
+        return output;
+    }
+
+    // Append "expression = result" to a caller-owned string; reusing the same string
+    // across calls avoids any allocation once it has grown
+    static void appendResult(std::string& output, std::string_view expression, double result, bool hasDecimal) {
+        char buffer[RESULT_BUFFER_SIZE];
+        size_t length = formatValue(buffer, result, hasDecimal);
+        output.append(expression).append(" = ").append(buffer, length);
+    }
+
+    // Write just the result value into buffer (at least RESULT_BUFFER_SIZE bytes).
+    // Integers print without decimals; everything else prints with two decimals.
+    // Returns the number of characters written.
+    static size_t formatValue(char* buffer, double result, bool hasDecimal) {
         long long intVal = static_cast<long long>(result);
+        char* end = buffer + RESULT_BUFFER_SIZE;
         
-        // Format the result value
-        std::string resultStr;
         if (std::abs(result - intVal) < 1e-9 && !hasDecimal) {
-            resultStr = std::to_string(intVal);
-        } else {
-            std::ostringstream ss;
-            ss << std::fixed << std::setprecision(2) << result;
-            resultStr = ss.str();
+            return std::to_chars(buffer, end, intVal).ptr - buffer;
         }
-        
-        // Return expression = result on single line
-        return expression + " = " + resultStr;
+#if defined(__cpp_lib_to_chars)
+        return std::to_chars(buffer, end, result, std::chars_format::fixed, 2).ptr - buffer;
+#else
+        return std::snprintf(buffer, RESULT_BUFFER_SIZE, "%.2f", result);
+#endif
     }
     
     // Check if expression contains a decimal point
-    static bool hasDecimalPoint(const std::string& expression) {
-        return expression.find('.') != std::string::npos;
+    static bool hasDecimalPoint(std::string_view expression) {
+        return expression.find('.') != std::string_view::npos;
     }
 };
 
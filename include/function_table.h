@@ -0,0 +1,88 @@
+#ifndef FUNCTION_TABLE_H
+#define FUNCTION_TABLE_H
+
+#include <cmath>
+#include <cstddef>
+#include <string_view>
+#include "compiled_expr.h"
+
+// Which sin/cos the Parser compiles calls to
+enum class TrigAccuracy {
+    EXACT,  // libm's sin and cos (SIN, COS)
+    FAST    // FastTrig polynomials (SIN_FAST, COS_FAST); see fast_trig.h for the error bound
+};
+
+// Built-in functions, resolved to an opcode by name when a call is parsed.
+// The names hash without collisions into a table of SLOTS entries, so a lookup is one
+// hash of the first two characters and the length, then one string compare. A new
+// function goes into FUNCTIONS; the static_assert below fails if its name collides,
+// and the hash then needs different characters.
+namespace FunctionTable {
+
+    struct Function {
+        std::string_view name;
+        OpCode op;
+        int arity;  // number of arguments
+    };
+
+    inline constexpr Function FUNCTIONS[] = {
+        {"sin", OpCode::SIN, 1},
+        {"cos", OpCode::COS, 1},
+        {"sqrt", OpCode::SQRT, 1},
+        {"exp", OpCode::EXP, 1},
+        {"log", OpCode::LOG, 1},
+        {"pow", OpCode::POW, 2},
+        {"min", OpCode::MIN, 2},
+        {"max", OpCode::MAX, 2},
+        {"atan2", OpCode::ATAN2, 2}
+    };
+
+    constexpr size_t SLOTS = 16;
+
+    // Names must have at least two characters
+    constexpr size_t hash(std::string_view name) {
+        return (static_cast<unsigned char>(name[0]) + static_cast<unsigned char>(name[1]) + name.size()) &
+               (SLOTS - 1);
+    }
+
+    struct SlotTable {
+        int entry[SLOTS] = {};  // 1 + index into FUNCTIONS, 0 for an empty slot
+        bool perfect = true;
+
+        constexpr SlotTable() {
+            for (size_t i = 0; i < sizeof(FUNCTIONS) / sizeof(FUNCTIONS[0]); i++) {
+                size_t slot = hash(FUNCTIONS[i].name);
+                if (entry[slot] != 0) perfect = false;
+                entry[slot] = static_cast<int>(i) + 1;
+            }
+        }
+    };
+
+    inline constexpr SlotTable TABLE{};
+    static_assert(TABLE.perfect, "two function names hash to the same slot");
+
+    // min and max as every evaluation path computes them: like std::fmin/std::fmax a
+    // NaN operand is ignored, and unlike them -0 counts as smaller than +0, so the
+    // result does not depend on how the compiler or libm implements them
+    inline double min(double a, double b) {
+        if (std::isnan(b)) return a;
+        if (std::isnan(a)) return b;
+        return a < b || (a == b && std::signbit(a)) ? a : b;
+    }
+
+    inline double max(double a, double b) {
+        if (std::isnan(b)) return a;
+        if (std::isnan(a)) return b;
+        return a > b || (a == b && !std::signbit(a)) ? a : b;
+    }
+
+    // The built-in function called `name`, or nullptr
+    constexpr const Function* find(std::string_view name) {
+        if (name.size() < 2) return nullptr;
+        int entry = TABLE.entry[hash(name)];
+        if (entry == 0 || FUNCTIONS[entry - 1].name != name) return nullptr;
+        return &FUNCTIONS[entry - 1];
+    }
+}
+
+#endif // FUNCTION_TABLE_H
@@ -0,0 +1,62 @@
+#ifndef JIT_COMPILER_H
+#define JIT_COMPILER_H
+
+#include <memory>
+#include <vector>
+#include "compiled_expr.h"
+
+// mmap'd pages holding the native code of several programs. Pages are only ever
+// writable or executable, never both; the chunk is unmapped once no JitCode uses it.
+class CodeChunk {
+public:
+    CodeChunk(void* memory, size_t size) : memory(memory), size(size) {}
+    ~CodeChunk();
+
+    CodeChunk(const CodeChunk&) = delete;
+    CodeChunk& operator=(const CodeChunk&) = delete;
+
+    void* const memory;
+    const size_t size;
+};
+
+// Native code for one compiled program (Linux x86-64 only).
+// The generated function takes the environment's value array and returns the result.
+class JitCode {
+public:
+    using Function = double (*)(double* values);
+
+    JitCode(std::shared_ptr<const CodeChunk> chunk, const void* entry, std::vector<int> reads, int storeSlot)
+        : chunk(std::move(chunk)), entry(entry), reads(std::move(reads)), storeSlot(storeSlot) {}
+
+    Function function() const { return reinterpret_cast<Function>(const_cast<void*>(entry)); }
+
+    std::shared_ptr<const CodeChunk> chunk;  // keeps the code mapped
+    const void* entry;
+    std::vector<int> reads;  // slots that must be defined before calling
+    int storeSlot;           // slot assigned by the program, or -1
+};
+
+// Translates stack-machine programs into SSE2 machine code in mmap'd executable pages.
+// Programs are packed one after another into chunks of CHUNK_SIZE bytes rather than
+// each getting its own pages: thousands of hot programs then share a few pages of
+// instruction cache and TLB entries. One compiler must only be used by one thread.
+class JitCompiler {
+public:
+    static constexpr size_t CHUNK_SIZE = 64 * 1024;
+
+    JitCompiler() = default;
+    JitCompiler(JitCompiler&&) = default;
+    JitCompiler& operator=(JitCompiler&&) = default;
+
+    // True when native code generation is supported on this platform
+    static bool isSupported();
+
+    // Generate native code for a program; returns nullptr if unsupported or on failure
+    std::shared_ptr<const JitCode> compile(const CompiledExpr& program);
+
+private:
+    std::shared_ptr<const CodeChunk> chunk;  // chunk being filled
+    size_t used = 0;                         // bytes of it already holding code
+};
+
+#endif // JIT_COMPILER_H
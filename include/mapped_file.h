@@ -0,0 +1,104 @@
+#ifndef MAPPED_FILE_H
+#define MAPPED_FILE_H
+
+#include <string>
+#include <string_view>
+#include <fstream>
+#include <iterator>
+
+#if defined(__unix__) || defined(__APPLE__)
+#define MAPPED_FILE_MMAP 1
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+// Read-only view of a whole file, backed by mmap where available.
+// Views handed out by contents() stay valid for the lifetime of the MappedFile.
+class MappedFile {
+public:
+    MappedFile() = default;
+
+    ~MappedFile() {
+        close();
+    }
+
+    MappedFile(MappedFile&& other) noexcept
+        : data(other.data), length(other.length), mapped(other.mapped), buffer(std::move(other.buffer)) {
+        if (!mapped) data = buffer.data();
+        other.data = nullptr;
+        other.length = 0;
+        other.mapped = false;
+    }
+
+    MappedFile& operator=(MappedFile&& other) noexcept {
+        if (this != &other) {
+            close();
+            data = other.data;
+            length = other.length;
+            mapped = other.mapped;
+            buffer = std::move(other.buffer);
+            if (!mapped) data = buffer.data();
+            other.data = nullptr;
+            other.length = 0;
+            other.mapped = false;
+        }
+        return *this;
+    }
+
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    // Map the file; returns false if it cannot be opened
+    bool open(const std::string& filename) {
+        close();
+#ifdef MAPPED_FILE_MMAP
+        int fd = ::open(filename.c_str(), O_RDONLY);
+        if (fd < 0) return false;
+
+        struct stat info;
+        if (fstat(fd, &info) == 0 && S_ISREG(info.st_mode) && info.st_size > 0) {
+            void* addr = mmap(nullptr, info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+            if (addr != MAP_FAILED) {
+                madvise(addr, info.st_size, MADV_SEQUENTIAL);
+                data = static_cast<const char*>(addr);
+                length = info.st_size;
+                mapped = true;
+                ::close(fd);
+                return true;
+            }
+        }
+        ::close(fd);
+#endif
+        // Empty files, pipes and platforms without mmap are read into memory instead
+        std::ifstream input(filename, std::ios::binary);
+        if (!input) return false;
+        buffer.assign(std::istreambuf_iterator<char>(input), std::istreambuf_iterator<char>());
+        data = buffer.data();
+        length = buffer.size();
+        return true;
+    }
+
+    std::string_view contents() const {
+        return std::string_view(data, length);
+    }
+
+private:
+    void close() {
+#ifdef MAPPED_FILE_MMAP
+        if (mapped) munmap(const_cast<char*>(data), length);
+#endif
+        data = nullptr;
+        length = 0;
+        mapped = false;
+        buffer.clear();
+    }
+
+    const char* data = nullptr;
+    size_t length = 0;
+    bool mapped = false;
+    std::string buffer;  // file contents when not mapped
+};
+
+#endif // MAPPED_FILE_H
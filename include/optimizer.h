@@ -0,0 +1,35 @@
+#ifndef OPTIMIZER_H
+#define OPTIMIZER_H
+
+#include <string>
+#include <vector>
+#include "compiled_expr.h"
+#include "symbol_table.h"
+
+// Simplifies compiled programs in place:
+//   - folds constant sub-expressions (2 ^ 3 * x  ->  8 * x, sin(0xFF) -> constant)
+//   - removes identities that cannot change an IEEE result: x * 1, 1 * x, x / 1, x - 0, x ^ 1
+// x + 0 is deliberately kept: it turns -0 into +0. x ^ 2 keeps std::pow: glibc's pow is
+// not correctly rounded, so x * x can differ from it in the last bit, and a literal
+// folded through std::pow would then disagree with the same formula on a variable.
+// The pass works directly on the postfix code with an explicit stack, so it never
+// recurses, and it allocates nothing once its stack has grown.
+class Optimizer {
+public:
+    void optimize(CompiledExpr& program);
+
+    // Render a program as a parenthesized prefix tree, e.g. "(* (^ 2 3) x)"
+    static std::string formatTree(const CompiledExpr& program, const SymbolTable& symbols);
+
+private:
+    // Code range [start, end of output) that computes one stack value
+    struct Segment {
+        size_t start;
+        bool isConst;
+        double value;
+    };
+
+    std::vector<Segment> segments;
+};
+
+#endif // OPTIMIZER_H
@@ -0,0 +1,171 @@
+#ifndef OUTPUT_SINK_H
+#define OUTPUT_SINK_H
+
+#include <condition_variable>
+#include <cstdio>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <thread>
+#include "stats.h"
+
+// Buffered output target for result files.
+// Text accumulates in a large user-space buffer which is written out only when it
+// fills up or when flush() is called (ResultWriter does so at category and session
+// boundaries). In async mode a background thread performs the writes: flush() swaps
+// the filled buffer with an empty one (double buffering) and returns immediately.
+class OutputSink {
+public:
+    static constexpr size_t DEFAULT_BUFFER_SIZE = 1 << 20;
+
+    // Open (truncate) a file; check isOpen() afterwards
+    explicit OutputSink(const std::string& filename, bool async = false,
+                        size_t bufferSize = DEFAULT_BUFFER_SIZE)
+        : name(filename), file(std::fopen(filename.c_str(), "wb")), ownsFile(true) {
+        // The sink does its own buffering; skip stdio's extra copy
+        if (file) std::setvbuf(file, nullptr, _IONBF, 0);
+        start(async, bufferSize);
+    }
+
+    // Write to an already-open stream such as stdout (not closed by the sink)
+    explicit OutputSink(std::FILE* stream, bool async = false,
+                        size_t bufferSize = DEFAULT_BUFFER_SIZE)
+        : name("<stream>"), file(stream), ownsFile(false) {
+        start(async, bufferSize);
+    }
+
+    ~OutputSink() {
+        try {
+            close();
+        } catch (...) {
+            // Destructors must not throw; call close() to observe write errors
+        }
+    }
+
+    OutputSink(const OutputSink&) = delete;
+    OutputSink& operator=(const OutputSink&) = delete;
+
+    bool isOpen() const { return file != nullptr; }
+
+    void write(std::string_view text) {
+        if (active.size() + text.size() > capacity) handOff();
+        if (text.size() > capacity) {
+            // Larger than a whole buffer: write it straight through
+            waitForWriter();
+            writeToFile(text);
+            return;
+        }
+        active.append(text);
+    }
+
+    OutputSink& operator<<(std::string_view text) {
+        write(text);
+        return *this;
+    }
+
+    OutputSink& operator<<(char c) {
+        if (active.size() + 1 > capacity) handOff();
+        active.push_back(c);
+        return *this;
+    }
+
+    // Hand buffered text to the OS (or to the writer thread in async mode)
+    void flush() {
+        handOff();
+        if (!async) std::fflush(file);
+    }
+
+    // Write everything, stop the writer thread and close the file.
+    // Throws if any write failed.
+    void close() {
+        if (!file) return;
+        handOff();
+        if (async) {
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                stopping = true;
+            }
+            changed.notify_all();
+            writer.join();
+            async = false;
+        }
+        bool ok = !failed && std::fflush(file) == 0;
+        if (ownsFile) ok = (std::fclose(file) == 0) && ok;
+        file = nullptr;
+        if (!ok) throw std::runtime_error("Error: could not write output file: " + name);
+    }
+
+private:
+    void start(bool useAsync, size_t bufferSize) {
+        capacity = bufferSize == 0 ? 1 : bufferSize;
+        async = useAsync && file != nullptr;
+        active.reserve(capacity);
+        if (async) {
+            pending.reserve(capacity);
+            writer = std::thread([this] { writerLoop(); });
+        }
+    }
+
+    // Send the active buffer on its way
+    void handOff() {
+        if (active.empty()) return;
+        if (!async) {
+            writeToFile(active);
+            active.clear();
+            return;
+        }
+        std::unique_lock<std::mutex> lock(mutex);
+        changed.wait(lock, [this] { return !pendingFull; });
+        active.swap(pending);
+        pendingFull = true;
+        lock.unlock();
+        changed.notify_all();
+        active.clear();
+    }
+
+    void waitForWriter() {
+        if (!async) return;
+        std::unique_lock<std::mutex> lock(mutex);
+        changed.wait(lock, [this] { return !pendingFull; });
+    }
+
+    void writerLoop() {
+        std::unique_lock<std::mutex> lock(mutex);
+        while (true) {
+            changed.wait(lock, [this] { return pendingFull || stopping; });
+            if (pendingFull) {
+                lock.unlock();
+                writeToFile(pending);
+                pending.clear();
+                lock.lock();
+                pendingFull = false;
+                changed.notify_all();
+                continue;
+            }
+            if (stopping) return;
+        }
+    }
+
+    void writeToFile(std::string_view text) {
+        Stats::addBytes(Stats::WRITE, text.size());
+        if (std::fwrite(text.data(), 1, text.size(), file) != text.size()) failed = true;
+    }
+
+    std::string name;
+    std::FILE* file;
+    bool ownsFile;
+    size_t capacity = DEFAULT_BUFFER_SIZE;
+    bool async = false;
+    bool failed = false;
+
+    std::string active;    // buffer being filled by the caller
+    std::string pending;   // buffer being written by the writer thread
+    bool pendingFull = false;
+    bool stopping = false;
+    std::mutex mutex;
+    std::condition_variable changed;
+    std::thread writer;
+};
+
+#endif // OUTPUT_SINK_H
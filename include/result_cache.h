@@ -0,0 +1,205 @@
+#ifndef RESULT_CACHE_H
+#define RESULT_CACHE_H
+
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <string_view>
+#include <vector>
+#include "compiled_expr.h"
+#include "symbol_table.h"
+#include "text_scan.h"
+
+// Bounded cache of evaluate() results, keyed by expression text with insignificant
+// whitespace removed. A result is reused only while every variable it read still has
+// the version it had when the result was stored, so an assignment invalidates exactly
+// the entries that read that variable. Assignments and errors are never cached.
+//
+// Direct-mapped: a new entry replaces whatever occupied its bucket, so memory stays
+// within the capacity (entries of at most MAX_KEY_LENGTH characters).
+class ResultCache {
+public:
+    static constexpr size_t DEFAULT_CAPACITY = 4096;
+    static constexpr size_t MAX_KEY_LENGTH = 256;  // longer expressions are not cached
+
+    // A lookup costs a pass over the text and a hit saves compiling it, both roughly in
+    // proportion to its length. When hits cover less than 1/MIN_HIT_RATIO of the text
+    // looked up in a window of WINDOW lookups, the cache is skipped for the next
+    // BYPASS_WINDOWS windows of evaluations and then tried again, so input that never
+    // repeats (or only repeats trivial lines like "x") pays almost nothing.
+    static constexpr size_t WINDOW = 4096;
+    static constexpr size_t MIN_HIT_RATIO = 8;
+    static constexpr size_t BYPASS_WINDOWS = 15;
+
+    explicit ResultCache(size_t capacity = DEFAULT_CAPACITY) { setCapacity(capacity); }
+
+    // Maximum number of entries, rounded up to a power of two; 0 turns the cache off.
+    // Drops every entry.
+    void setCapacity(size_t entries) {
+        size_t rounded = entries ? 1 : 0;
+        while (rounded && rounded < entries) rounded <<= 1;
+        limit = rounded;
+        buckets.clear();
+        buckets.shrink_to_fit();
+        seen.clear();
+        seen.shrink_to_fit();
+    }
+
+    size_t capacity() const { return limit; }
+    bool enabled() const { return limit != 0; }
+
+    // Drop every entry in O(1); counters are kept
+    void clear() { generation++; }
+
+    uint64_t hits() const { return hitCount; }
+    uint64_t misses() const { return missCount; }
+
+    // Look an expression up, remembering its key for store(). True on a hit, with the
+    // cached value and ExprFeature bits. While the cache is bypassed, every lookup misses.
+    bool lookup(std::string_view expression, const Environment& env, double& value, unsigned& features) {
+        keyUsable = false;
+        if (bypass) {
+            bypass--;
+            missCount++;
+            return false;
+        }
+        if (++windowLookups == WINDOW) {
+            if (windowHitChars * MIN_HIT_RATIO < windowChars) bypass = BYPASS_WINDOWS * WINDOW;
+            windowLookups = 0;
+            windowChars = 0;
+            windowHitChars = 0;
+        }
+        windowChars += expression.size();
+
+        keyUsable = normalize(expression);
+        if (keyUsable) {
+            keyHash = hash(keyBuffer, keyLength);
+            const Entry* entry = buckets.empty() ? nullptr : &buckets[keyHash & (limit - 1)];
+            if (entry && entry->generation == generation && entry->hash == keyHash &&
+                entry->key == std::string_view(keyBuffer, keyLength) && current(*entry, env)) {
+                value = entry->value;
+                features = entry->features;
+                hitCount++;
+                windowHitChars += expression.size();
+                return true;
+            }
+        }
+        missCount++;
+        return false;
+    }
+
+    // Remember the result of the expression passed to the last lookup(), given the
+    // program that computed it and the environment it ran against. An expression is only
+    // admitted the second time it misses, so inputs that never repeat do not churn the cache.
+    void store(const CompiledExpr& program, const Environment& env, double value) {
+        if (!limit || !keyUsable || program.features & FEATURE_ASSIGNMENT) return;
+
+        if (buckets.empty()) {
+            buckets.resize(limit);
+            seen.assign(limit, 0);
+        }
+        size_t index = keyHash & (limit - 1);
+        uint32_t fingerprint = static_cast<uint32_t>(keyHash >> 32) | 1;
+        if (seen[index] != fingerprint) {
+            seen[index] = fingerprint;
+            return;
+        }
+
+        Entry& entry = buckets[index];
+        entry.generation = generation;
+        entry.hash = keyHash;
+        entry.key.assign(keyBuffer, keyLength);
+        entry.value = value;
+        entry.features = program.features;
+        entry.reads.clear();
+        for (const Instruction& ins : program.code) {
+            if (ins.op != OpCode::LOAD_VAR) continue;
+            bool found = false;
+            for (const Read& read : entry.reads) found = found || read.slot == ins.arg;
+            if (!found) entry.reads.push_back(Read{ins.arg, env.versions[ins.arg]});
+        }
+    }
+
+private:
+    struct Read {
+        int slot;
+        uint64_t version;  // Environment::versions[slot] when the result was computed
+    };
+
+    struct Entry {
+        uint64_t generation = 0;  // entries from before the last clear() do not match
+        uint64_t hash = 0;
+        std::string key;
+        double value = 0.0;
+        unsigned features = 0;
+        std::vector<Read> reads;
+    };
+
+    static bool current(const Entry& entry, const Environment& env) {
+        for (const Read& read : entry.reads) {
+            if (env.versions[read.slot] != read.version) return false;
+        }
+        return true;
+    }
+
+    // Copy the expression into keyBuffer with every whitespace run removed, except one
+    // space between word characters (the characters of names and numbers: "1 2" is 1
+    // followed by ignored input, "12" is twelve). False (key not usable) if it is longer
+    // than MAX_KEY_LENGTH. Written without data-dependent branches: each character is
+    // stored and then kept or not.
+    bool normalize(std::string_view expression) {
+        size_t n = 0;
+        bool afterSpace = false;  // previous character was whitespace
+        bool lastWord = false;    // last non-space character was a word character
+        for (char c : expression) {
+            uint8_t cls = TextScan::CLASSES.of[static_cast<unsigned char>(c)];
+            bool space = cls & TextScan::SPACE;
+            bool word = cls & (TextScan::IDENTIFIER | TextScan::DECIMAL);
+            keyBuffer[n] = ' ';
+            n += afterSpace & lastWord & word;
+            keyBuffer[n] = c;
+            n += !space;
+            afterSpace = space;
+            lastWord = (lastWord & space) | word;
+            if (n > MAX_KEY_LENGTH) return false;
+        }
+        keyLength = n;
+        return true;
+    }
+
+    // 64-bit multiply-xorshift hash, eight bytes at a time
+    static uint64_t hash(const char* data, size_t length) {
+        const uint64_t K = 0x9E3779B97F4A7C15ULL;
+        uint64_t h = length * K;
+        size_t i = 0;
+        for (; i + 8 <= length; i += 8) {
+            uint64_t word;
+            std::memcpy(&word, data + i, 8);
+            h = (h ^ word) * K;
+            h ^= h >> 32;
+        }
+        uint64_t tail = 0;
+        std::memcpy(&tail, data + i, length - i);
+        h = (h ^ tail) * K;
+        h ^= h >> 29;
+        h *= 0xBF58476D1CE4E5B9ULL;
+        return h ^ (h >> 32);
+    }
+
+    std::vector<Entry> buckets;   // allocated on first store
+    std::vector<uint32_t> seen;   // per bucket: fingerprint of the last expression that missed there
+    size_t limit = 0;
+    uint64_t generation = 1;
+    uint64_t hitCount = 0;
+    uint64_t missCount = 0;
+    size_t windowLookups = 0;
+    size_t windowChars = 0;              // text looked up in the current window
+    size_t windowHitChars = 0;           // of which found in the cache
+    size_t bypass = 0;                   // evaluations left before the cache is tried again
+    char keyBuffer[MAX_KEY_LENGTH + 2];  // normalized text of the last lookup
+    size_t keyLength = 0;
+    uint64_t keyHash = 0;
+    bool keyUsable = false;              // keyBuffer holds a cacheable key for store()
+};
+
+#endif // RESULT_CACHE_H
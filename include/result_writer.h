@@ -1,19 +1,24 @@
 #ifndef RESULT_WRITER_H
 #define RESULT_WRITER_H
 
-#include <fstream>
+#include <istream>
+#include <ostream>
 #include <string>
 #include <vector>
 #include <stdexcept>
 #include "expression_processor.h"
 #include "categorizer.h"
+#include "output_sink.h"
+#include "stats.h"
 
 class ResultWriter {
 public:
     // Write categorized results to output file
-    static void writeResults(const std::string& filename, const CategoryResults& results) {
-        std::ofstream output(filename);
-        if (!output) {
+    static void writeResults(const std::string& filename, const CategoryResults& results,
+                             bool asyncWrites = false) {
+        Stats::Timer timer(Stats::WRITE);
+        OutputSink output(filename, asyncWrites);
+        if (!output.isOpen()) {
             throw std::runtime_error("Error: could not open output file: " + filename);
         }
         
@@ -25,55 +30,79 @@ public:
         output.close();
     }
 
-    // Write a single session's results to an already-open output stream
+    // Append one result in category format to a spill segment (see writeSegment)
+    static void writeItem(std::ostream& segment, const std::string& item) {
+        Stats::Timer timer(Stats::WRITE);
+        segment << "------\n" << item << '\n';
+    }
+
+    // Write a non-empty category whose items were spilled to a segment with writeItem()
+    static void writeSegment(OutputSink& output, Categorizer::Category cat, std::istream& segment) {
+        Stats::Timer timer(Stats::WRITE);
+        output << Categorizer::getCategoryName(cat) << '\n';
+        char chunk[64 * 1024];
+        while (segment.read(chunk, sizeof(chunk)) || segment.gcount() > 0) {
+            output.write(std::string_view(chunk, segment.gcount()));
+        }
+        output << '\n';
+        output.flush();
+    }
+
+    // Write a single session's results to an already-open output sink
     // Legacy: write categorized results for a session (keeps previous behavior)
-    static void writeSession(std::ofstream& output, int sessionNumber, const CategoryResults& results) {
-        output << "----" << std::endl;
-        output << "Session " << sessionNumber << std::endl;
+    static void writeSession(OutputSink& output, int sessionNumber, const CategoryResults& results) {
+        Stats::Timer timer(Stats::WRITE);
+        output << "----\n";
+        output << "Session " << std::to_string(sessionNumber) << '\n';
         writeCategory(output, Categorizer::BASIC_CALC, results.basicCalc);
         writeCategory(output, Categorizer::HEX_BINARY, results.hexBinary);
         writeCategory(output, Categorizer::VARIABLES, results.variables);
         writeCategory(output, Categorizer::ADVANCED, results.advanced);
+        output.flush();
     }
 
     // Preferred: write a session block showing header, variable definitions, then expression(s)
-    static void writeSession(std::ofstream& output,
+    static void writeSession(OutputSink& output,
                              int sessionNumber,
                              const std::vector<std::string>& variableDefs,
                              const std::vector<std::string>& expressionOutputs) {
-        output << "----" << std::endl;
-        output << "Session " << sessionNumber << std::endl;
+        Stats::Timer timer(Stats::WRITE);
+        output << "----\n";
+        output << "Session " << std::to_string(sessionNumber) << '\n';
 
         // Write variable definitions section
         if (!variableDefs.empty()) {
-            output << "Variables:" << std::endl;
+            output << "Variables:\n";
             for (const auto& v : variableDefs) {
-                output << "  " << v << std::endl;
+                output << "  " << v << '\n';
             }
         }
 
         // Write expression section
         if (!expressionOutputs.empty()) {
-            output << "Expression:" << std::endl;
+            output << "Expression:\n";
             for (const auto& e : expressionOutputs) {
-                output << "  " << e << std::endl;
+                output << "  " << e << '\n';
             }
         }
+        output.flush();
     }
 
 private:
-    // Helper method to write a category if it has results
-    static void writeCategory(std::ofstream& output,
+    // Helper method to write a category if it has results.
+    // Lines are buffered; the sink is flushed once the category is complete.
+    static void writeCategory(OutputSink& output,
                              Categorizer::Category cat,
                              const std::vector<std::string>& items) {
         if (items.empty()) return;
         
-        output << Categorizer::getCategoryName(cat) << std::endl;
+        output << Categorizer::getCategoryName(cat) << '\n';
         for (const auto& item : items) {
-            output << "------" << std::endl;
-            output << item << std::endl;
+            output << "------\n";
+            output << item << '\n';
         }
-        output << std::endl;
+        output << '\n';
+        output.flush();
     }
 };
 
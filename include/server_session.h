@@ -0,0 +1,109 @@
+#ifndef SERVER_SESSION_H
+#define SERVER_SESSION_H
+
+#include <algorithm>
+#include <string>
+#include <string_view>
+#include "evaluator.h"
+#include "formatter.h"
+#include "text_utils.h"
+
+// Line protocol of calc_server, shared by its stdin and socket modes.
+// Every non-empty request line gets exactly one response line, in request order:
+//   expression or assignment  ->  its value, formatted as in output.txt
+//   function definition       ->  0; the function can be called until the session ends
+//   line that fails           ->  "Error: <message>"
+//   "----"                    ->  "----", and a new session starts (variables and functions are cleared)
+//   line over MAX_LINE_LENGTH ->  "Error: Line longer than 65536 bytes", answered as soon as
+//                                 the limit is passed; the rest of the line is discarded
+// Blank lines get no response.
+class ServerSession {
+public:
+    static constexpr size_t MAX_LINE_LENGTH = 64 * 1024;
+
+    // Handle every complete line at the front of input and append the responses to
+    // output. The unterminated tail of input is left in place for the next call, which
+    // only scans the bytes appended since; a tail longer than MAX_LINE_LENGTH is answered
+    // with an error and dropped, so input never holds more than one line's worth.
+    // Returns the number of lines answered.
+    size_t consume(std::string& input, std::string& output) {
+        size_t pos = 0;
+        size_t handled = 0;
+        while (true) {
+            size_t end = TextScan::find(input, std::max(pos, scanned), '\n');
+            if (end == input.size()) break;
+            if (discarding) {
+                discarding = false;  // end of a line already answered as too long
+            } else if (end - pos > MAX_LINE_LENGTH) {
+                appendTooLong(output);
+                handled++;
+            } else {
+                handleLine(std::string_view(input).substr(pos, end - pos), output);
+                handled++;
+            }
+            pos = end + 1;
+        }
+        input.erase(0, pos);
+        scanned = input.size();
+
+        if (input.size() > MAX_LINE_LENGTH) {
+            if (!discarding) {
+                appendTooLong(output);
+                handled++;
+                discarding = true;
+            }
+            input.clear();
+            scanned = 0;
+        }
+        return handled;
+    }
+
+    // Handle what is left in input at the end of the stream: a last line without '\n'
+    void finish(std::string& input, std::string& output) {
+        if (!discarding) {
+            if (input.size() > MAX_LINE_LENGTH) {
+                appendTooLong(output);
+            } else {
+                handleLine(input, output);
+            }
+        }
+        input.clear();
+        scanned = 0;
+        discarding = false;
+    }
+
+    // calc_server --no-jit: interpret every program
+    void setJitEnabled(bool enabled) { evaluator.setJitEnabled(enabled); }
+
+    // Handle one request line (with or without its '\n')
+    void handleLine(std::string_view line, std::string& output) {
+        line = TextUtils::trim(line);
+        if (line.empty()) return;
+
+        if (TextUtils::isSessionSeparator(line)) {
+            evaluator.reset();
+            output.append("----\n");
+            return;
+        }
+
+        try {
+            double result = evaluator.evaluate(line);
+            char buffer[Formatter::RESULT_BUFFER_SIZE];
+            size_t length = Formatter::formatValue(buffer, result, Formatter::hasDecimalPoint(line));
+            output.append(buffer, length).push_back('\n');
+        } catch (const std::exception& e) {
+            output.append("Error: ").append(e.what()).push_back('\n');
+        }
+    }
+
+private:
+    static void appendTooLong(std::string& output) {
+        output.append("Error: Line longer than ").append(std::to_string(MAX_LINE_LENGTH)).append(" bytes\n");
+    }
+
+    Evaluator evaluator;
+    size_t scanned = 0;       // bytes at the front of the caller's input known to hold no '\n'
+    bool discarding = false;  // inside a line answered as too long, skipping to its '\n'
+};
+
+#endif // SERVER_SESSION_H
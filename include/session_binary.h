@@ -0,0 +1,199 @@
+#ifndef SESSION_BINARY_H
+#define SESSION_BINARY_H
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+#include "compiled_expr.h"
+#include "evaluator.h"
+#include "mapped_file.h"
+#include "session_parser.h"
+
+// Binary session file: a calculator/session text file stored verbatim, with the program
+// each of its non-empty lines compiles to, so loading needs no parsing at all.
+//
+// Layout (host byte order, every section 8-byte aligned, offsets from file start):
+//   Header
+//   double[constantCount]           distinct PUSH_CONST values that are not small whole numbers
+//   text                            the source file, byte for byte
+//   line table                      one variable-length record per non-empty line
+//   session table                   sessions as SessionParser groups them
+//   scope table                     variable names of each "----" block
+//   code                            instructions of every program, in line order
+//
+// Records are sequences of unsigned LEB128 varints ("v" below), so small numbers take
+// one byte. Offsets and scopes that follow from file order are not stored:
+//   line       v gap (bytes from the end of the previous line's text, trimmed, to this one's)
+//              v length, v kind | HAS_SESSION_ERROR | features << 4
+//              non-separators: v maxStack, v code bytes, and with HAS_SESSION_ERROR
+//              v session error bytes (stored in the code section after the line's code)
+//   session    v sessionNumber - previous, v firstLine - previous, v variableCount,
+//              v expressionCount
+//   scope      v nameCount, then per name: v length, name bytes
+//   code       per instruction: op byte; LOAD_VAR/STORE_VAR: v scope-local slot;
+//              PUSH_CONST: v (value << 1 | 1) for a whole number below 2^31, otherwise
+//              v (constant index << 1). A SYNTAX_ERROR line's code is its message.
+//
+// Programs are optimized and their LOAD_VAR/STORE_VAR slots are local to the line's
+// scope: the lines from one "----" to the next (lines before the first "----" form
+// scope 0). A reader interns a scope's names into its evaluator and remaps the slots.
+// Functions defined in one scope stay callable in later ones, as in the calculator;
+// a line that needs one also records the error it gives without them (see sessionError).
+namespace SessionBinaryFormat {
+
+constexpr char MAGIC[8] = {'C', 'A', 'L', 'C', 'S', 'E', 'S', '\0'};
+constexpr uint32_t VERSION = 3;
+constexpr uint32_t BYTE_ORDER_MARK = 0x01020304;
+
+enum LineKind : uint8_t {
+    SEPARATOR,            // "----"
+    EXPRESSION,           // program without assignment
+    ASSIGNMENT,           // program ending in STORE_VAR
+    CONSTANT_ASSIGNMENT,  // "name = <constant>": PUSH_CONST, STORE_VAR; applied without running it
+    SYNTAX_ERROR          // did not compile; code holds the parser's error
+};
+
+// Flag in a line record's kind field: a session error follows the line's code
+constexpr uint32_t HAS_SESSION_ERROR = 8;
+
+struct Header {
+    char magic[8];
+    uint32_t version;
+    uint32_t byteOrder;
+    uint32_t lineCount;
+    uint32_t sessionCount;
+    uint32_t scopeCount;
+    uint32_t reserved;
+    uint64_t constantCount;
+    uint64_t textBytes;
+    uint64_t lineBytes;
+    uint64_t sessionBytes;
+    uint64_t scopeBytes;
+    uint64_t codeBytes;
+    uint64_t constantsOffset;
+    uint64_t textOffset;
+    uint64_t linesOffset;
+    uint64_t sessionsOffset;
+    uint64_t scopesOffset;
+    uint64_t codeOffset;
+};
+
+static_assert(sizeof(Header) == 128, "session file header layout");
+
+// A line record as load() decodes it
+struct Line {
+    uint32_t textOffset;      // trimmed line text in the text section
+    uint32_t textLength;
+    uint32_t codeOffset;      // in the code section
+    uint32_t codeLength;      // bytes
+    uint32_t instructions;    // decoded instruction count
+    uint32_t maxStack;        // deepest operand stack the program needs
+    uint32_t features;        // ExprFeature bits (for errors: those seen before the error)
+    uint32_t sessionErrorLength;  // bytes of the session error after the code, 0 if none
+    uint32_t scope;
+    LineKind kind;
+};
+
+struct SessionRecord {
+    uint32_t sessionNumber;
+    uint32_t firstLine;       // index into the line records
+    uint32_t variableCount;
+    uint32_t expressionCount;
+};
+
+struct ScopeRecord {
+    uint32_t firstSymbol;     // into the decoded symbol names
+    uint32_t symbolCount;     // symbol i of the scope is slot i in its programs
+};
+
+} // namespace SessionBinaryFormat
+
+// Read-only view of a binary session file. load() validates the file and decodes the
+// line, session and scope tables (a few varints per line); text, names and constants
+// are then used directly from the mapping, and programs are only decoded (with their
+// slots remapped) when they run.
+class SessionBinary {
+public:
+    // Whether the file starts with the binary session magic (false if unreadable)
+    static bool isBinaryFile(const std::string& filename);
+
+    // Compile text (calculator input or sessions) into the binary format
+    static std::string fromText(std::string_view text);
+
+    // Map and validate a binary file; throws if it cannot be opened or is malformed
+    void load(const std::string& filename);
+
+    // The text the file was built from, byte for byte
+    std::string_view text() const { return std::string_view(textData, header->textBytes); }
+
+    size_t lineCount() const { return lines.size(); }
+    size_t expressionCount() const { return expressions; }  // lines other than separators
+    std::string_view lineText(size_t line) const {
+        return std::string_view(textData + lines[line].textOffset, lines[line].textLength);
+    }
+    SessionBinaryFormat::LineKind lineKind(size_t line) const { return lines[line].kind; }
+    unsigned lineFeatures(size_t line) const { return lines[line].features; }
+    uint32_t lineScope(size_t line) const { return lines[line].scope; }
+
+    // The parser error a line gives when only functions defined since the last "----"
+    // exist, as for session_analyzer, which starts each session over; empty when that
+    // makes no difference. run() follows the calculator, which keeps functions across "----".
+    std::string_view sessionError(size_t line) const {
+        const SessionBinaryFormat::Line& record = lines[line];
+        return std::string_view(codeData + record.codeOffset + record.codeLength, record.sessionErrorLength);
+    }
+
+    size_t sessionCount() const { return sessionRecords.size(); }
+
+    // Replace session's lines with those of session `index`, allocated from the
+    // session's own memory resource; Session::firstLine indexes this file's lines
+    void session(size_t index, Session& session) const;
+
+    // Intern the names of a scope into an evaluator; slots[i] becomes the evaluator
+    // slot of the scope's symbol i
+    void bindScope(uint32_t scope, Evaluator& evaluator, std::vector<int>& slots) const;
+
+    // Run one line against an evaluator whose scope was bound into slots, as
+    // evaluator.evaluate(lineText(line)) would after evaluating every earlier line of
+    // the file: same value, same exceptions.
+    // The program is loaded into the caller's reusable `program`.
+    double run(size_t line, Evaluator& evaluator, const std::vector<int>& slots,
+               CompiledExpr& program) const;
+
+private:
+    // run() without the --stats timer, so errors do not unwind through it when stats are off
+    double runLine(size_t line, Evaluator& evaluator, const std::vector<int>& slots,
+                   CompiledExpr& program) const;
+
+    // Value of a PUSH_CONST operand
+    double constant(uint32_t operand) const {
+        return operand & 1 ? static_cast<double>(operand >> 1) : constants[operand >> 1];
+    }
+
+    std::string_view code(const SessionBinaryFormat::Line& line) const {
+        return std::string_view(codeData + line.codeOffset, line.codeLength);
+    }
+
+    // Count a line's instructions, throwing unless its program only uses its scope's
+    // slots and the file's constants and keeps the operand stack within maxStack,
+    // ending with exactly one value
+    uint32_t validateProgram(const SessionBinaryFormat::Line& line, const std::string& filename) const;
+
+    // Decode a line's instructions into program with remapped slots
+    void loadProgram(const SessionBinaryFormat::Line& line, const std::vector<int>& slots,
+                     CompiledExpr& program) const;
+
+    MappedFile file;
+    const SessionBinaryFormat::Header* header = nullptr;
+    const double* constants = nullptr;
+    const char* textData = nullptr;
+    const char* codeData = nullptr;
+    std::vector<SessionBinaryFormat::Line> lines;
+    std::vector<SessionBinaryFormat::SessionRecord> sessionRecords;
+    std::vector<SessionBinaryFormat::ScopeRecord> scopes;
+    std::vector<std::string_view> symbols;  // names of every scope, in the mapping
+    size_t expressions = 0;
+};
+
+#endif // SESSION_BINARY_H
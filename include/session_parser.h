@@ -1,122 +1,268 @@
 #ifndef SESSION_PARSER_H
 #define SESSION_PARSER_H
 
-#include <fstream>
+#include <algorithm>
+#include <cstdio>
+#include <memory_resource>
 #include <string>
+#include <string_view>
 #include <vector>
 #include <stdexcept>
 #include <sstream>
+#include "mapped_file.h"
+#include "stats.h"
+#include "text_scan.h"
+#include "text_utils.h"
 
+// Lines are allocated from the memory resource passed to the parser, so a whole
+// file of sessions can live in one arena. Sessions move but do not copy: a copy would
+// silently allocate its lines from the default resource instead of the arena.
 struct Session {
+    explicit Session(std::pmr::memory_resource* resource = std::pmr::get_default_resource())
+        : variables(resource), expressions(resource) {}
+    Session(const Session&) = delete;
+    Session& operator=(const Session&) = delete;
+    Session(Session&&) = default;
+    Session& operator=(Session&&) = default;
+
+    int sessionNumber = 0;
+    int variableCount = 0;
+    int expressionCount = 0;
+    std::pmr::vector<std::pmr::string> variables;
+    std::pmr::vector<std::pmr::string> expressions;
+    size_t firstLine = 0;  // index of the session's first variable among the file's non-empty lines
+};
+
+// Where a session's lines are, as indices into the file's non-empty trimmed lines
+struct SessionSpan {
     int sessionNumber;
+    size_t firstLine;
     int variableCount;
     int expressionCount;
-    std::vector<std::string> variables;
-    std::vector<std::string> expressions;
 };
 
-class SessionParser {
+// Pull-based reader that yields the sessions of a file, of standard input or of
+// in-memory text one at a time, grouped as described at next(). Only the session being
+// read is held, so memory use does not depend on the size of the input:
+// a regular file is mapped and scanned in place, stdin is read in chunks.
+//
+// The one exception is stdin before its first "----": those lines are held until a
+// separator shows up, because input without any separator is grouped differently.
+class SessionStream {
 public:
-   static std::vector<Session> parseSessions(const std::string& filename) {
-        std::ifstream file(filename);
-        if (!file) {
+    static constexpr size_t READ_CHUNK = 64 * 1024;
+
+    // Open a file, or standard input for "-"; throws if the file cannot be opened
+    explicit SessionStream(const std::string& filename) {
+        if (filename == "-") {
+            input = stdin;
+            endOfInput = false;
+            return;
+        }
+        if (!file.open(filename)) {
             throw std::runtime_error("Error: could not open file: " + filename);
         }
-        
-        std::vector<Session> sessions;
-        std::string line;
-        int sessionNum = 0;
-        Session currentSession;
-        bool inSession = false;
-        bool awaitingExpression = false;
-        std::vector<std::string> outsideLines;
-        
-        while (std::getline(file, line)) {
-            line = trim(line);
-            
-            if (line.empty()) continue;
-            
-            if (line == "----") {
-                if (inSession && sessionNum > 0) {
-                    sessions.push_back(currentSession);
-                }
+        text = file.contents();
+    }
 
-                sessionNum++;
-                currentSession = Session{
-                    sessionNum,
-                    0,
-                    0,
-                    std::vector<std::string>(),
-                    std::vector<std::string>()
-                };
-                inSession = true;
-                awaitingExpression = true;
-                continue;
-            }
+    // Read sessions from text that outlives the stream
+    explicit SessionStream(std::string_view text) : text(text) {}
+
+    SessionStream(const SessionStream&) = delete;
+    SessionStream& operator=(const SessionStream&) = delete;
+
+    // Replace session's lines with the next session's, allocated from the session's own
+    // memory resource; false once the input is exhausted.
+    //
+    // Sessions are made of the non-empty trimmed lines. A "----" line starts a session:
+    // its variables (lines containing '='), then its expression, if any. Lines after a
+    // session's expression and before the next "----" belong to no session, unless the
+    // input has no "----" at all; then every line is grouped instead.
+    bool next(Session& session) {
+        session.variables.clear();
+        session.expressions.clear();
+        return advance(session.sessionNumber, session.firstLine, session.variableCount,
+                       session.expressionCount, [&session](bool variable, std::string_view line) {
+            (variable ? session.variables : session.expressions).emplace_back(line);
+        });
+    }
+
+    // Same grouping, reporting only where the session's lines are: span.firstLine
+    // counts the non-empty trimmed lines before it
+    bool next(SessionSpan& span) {
+        return advance(span.sessionNumber, span.firstLine, span.variableCount,
+                       span.expressionCount, [](bool, std::string_view) {});
+    }
 
-            if (!inSession) {
-                outsideLines.push_back(line);
-                continue;
+    // Bytes of input consumed so far
+    size_t bytesRead() const { return bytes; }
+
+private:
+    // The grouping behind both next() overloads; onLine(isVariable, line) receives
+    // each line of the session while it is valid
+    template <typename OnLine>
+    bool advance(int& sessionNumber, size_t& firstLine, int& variableCount, int& expressionCount,
+                 OnLine onLine) {
+        if (!modeKnown) findMode();
+        variableCount = 0;
+        expressionCount = 0;
+        std::string_view line;
+
+        if (!separated) {
+            if (!readLine(line)) return false;
+            sessionNumber = ++sessions;
+            firstLine = lineIndex - 1;
+            while (line.find('=') != std::string_view::npos) {
+                onLine(true, line);
+                variableCount++;
+                if (!readLine(line)) return true;
             }
+            onLine(false, line);
+            expressionCount = 1;
+            return true;
+        }
 
-            if (awaitingExpression && line.find('=') != std::string::npos) {
-                currentSession.variables.push_back(line);
-                currentSession.variableCount++;
-                continue;
+        if (!atSeparator) {
+            do {
+                if (!readLine(line)) return false;
+            } while (!TextUtils::isSessionSeparator(line));
+        }
+        atSeparator = false;
+        sessionNumber = ++sessions;
+        firstLine = lineIndex;
+
+        while (readLine(line)) {
+            if (TextUtils::isSessionSeparator(line)) {
+                atSeparator = true;
+                return true;
+            }
+            bool variable = line.find('=') != std::string_view::npos;
+            onLine(variable, line);
+            if (!variable) {
+                expressionCount = 1;
+                return true;
             }
+            variableCount++;
+        }
+        return true;
+    }
 
-            if (awaitingExpression && !line.empty()) {
-                currentSession.expressions.push_back(line);
-                currentSession.expressionCount = 1;
-                sessions.push_back(currentSession);
-                inSession = false;
-                awaitingExpression = false;
+    // Decide, before the first session, whether the input has a "----" line.
+    // Mapped text is scanned ahead; stdin is held until its first separator.
+    void findMode() {
+        modeKnown = true;
+        if (!input) {
+            std::string_view line;
+            size_t scan = pos;
+            while (TextUtils::nextLine(text, scan, line)) {
+                if (TextUtils::isSessionSeparator(TextUtils::trim(line))) {
+                    separated = true;
+                    return;
+                }
             }
+            return;
         }
-        
-        if (inSession && sessionNum > 0) {
-            sessions.push_back(currentSession);
+
+        std::string_view line;
+        while (readLine(line)) {
+            if (TextUtils::isSessionSeparator(line)) {
+                separated = true;
+                atSeparator = true;
+                held.clear();
+                return;
+            }
+            held.emplace_back(line);
         }
+        // No separator: group the held lines, numbered from the first again
+        replaying = true;
+        lineIndex = 0;
+    }
 
-        if (sessions.empty() && !outsideLines.empty()) {
-            size_t i = 0;
-            const size_t n = outsideLines.size();
-            while (i < n) {
-                std::vector<std::string> vars;
-                while (i < n && outsideLines[i].find('=') != std::string::npos) {
-                    vars.push_back(outsideLines[i]);
-                    ++i;
-                }
+    // Next non-empty trimmed line; the view is valid until the next call
+    bool readLine(std::string_view& line) {
+        if (replaying) {
+            if (lineIndex == held.size()) return false;
+            line = held[lineIndex++];
+            return true;
+        }
+        while (nextRawLine(line)) {
+            line = TextUtils::trim(line);
+            if (!line.empty()) {
+                lineIndex++;
+                return true;
+            }
+        }
+        return false;
+    }
 
-                if (i < n) {
-                    std::string expr = outsideLines[i];
-                    ++i;
-                    sessionNum++;
-                    Session s{
-                        sessionNum,
-                        static_cast<int>(vars.size()),
-                        1,
-                        vars,
-                        std::vector<std::string>{expr}
-                    };
-                    sessions.push_back(s);
-                } else {
-                    sessionNum++;
-                    Session s{
-                        sessionNum,
-                        static_cast<int>(vars.size()),
-                        0,
-                        vars,
-                        std::vector<std::string>()
-                    };
-                    sessions.push_back(s);
-                }
+    bool nextRawLine(std::string_view& line) {
+        while (true) {
+            size_t end = TextScan::find(text, pos, '\n');
+            if (end < text.size() || endOfInput) {
+                if (pos >= text.size()) return false;
+                line = text.substr(pos, end - pos);
+                bytes += std::min(end + 1, text.size()) - pos;
+                pos = end + 1;
+                return true;
             }
+            refill();
+        }
+    }
+
+    // stdin: drop the consumed bytes and read another chunk
+    void refill() {
+        pending.erase(0, pos);
+        pos = 0;
+        size_t kept = pending.size();
+        pending.resize(kept + READ_CHUNK);
+        size_t got = std::fread(&pending[kept], 1, READ_CHUNK, input);
+        pending.resize(kept + got);
+        if (got == 0) {
+            if (std::ferror(input)) throw std::runtime_error("Error: could not read standard input");
+            endOfInput = true;
         }
-        
-        file.close();
+        text = pending;
+    }
+
+    MappedFile file;
+    std::string_view text;          // mapped file, caller's text, or stdin bytes not yet consumed
+    size_t pos = 0;
+    std::FILE* input = nullptr;     // stdin when streaming it
+    std::string pending;
+    bool endOfInput = true;
+    std::vector<std::string> held;  // stdin lines before the first "----"
+    bool replaying = false;         // reading held lines
+    bool modeKnown = false;
+    bool separated = false;         // the input has a "----" line
+    bool atSeparator = false;       // a "----" was read and its session not yet started
+    int sessions = 0;
+    size_t lineIndex = 0;           // non-empty lines read so far
+    size_t bytes = 0;
+};
+
+class SessionParser {
+public:
+   // Session lines are allocated from `resource`, which must outlive the sessions
+   static std::vector<Session> parseSessions(const std::string& filename,
+                                             std::pmr::memory_resource* resource = std::pmr::get_default_resource()) {
+        Stats::Timer timer(Stats::READ);
+        SessionStream stream(filename);
+        std::vector<Session> sessions = readAll(stream, resource);
+        Stats::addBytes(Stats::READ, stream.bytesRead());
         return sessions;
     }
+
+    // Parse sessions from in-memory text; only the lines kept in a Session are copied
+    static std::vector<Session> parseSessionText(std::string_view text,
+                                                 std::pmr::memory_resource* resource = std::pmr::get_default_resource()) {
+        SessionStream stream(text);
+        return readAll(stream, resource);
+    }
+
+    // Empty session whose lines will be allocated from resource
+    static Session newSession(std::pmr::memory_resource* resource = std::pmr::get_default_resource()) {
+        return Session(resource);
+    }
     
     static int countSessions(const std::vector<Session>& sessions) {
         return sessions.size();
@@ -139,30 +285,40 @@ public:
     }
     
     static std::string getSummary(const std::vector<Session>& sessions) {
+        std::string summary = getSummaryHeader(sessions.size(), countTotalVariables(sessions),
+                                               countTotalExpressions(sessions));
+        for (const auto& session : sessions) {
+            appendSummaryEntry(summary, session);
+        }
+        return summary;
+    }
+
+    // The two parts of getSummary(), for callers that see one session at a time
+    static std::string getSummaryHeader(size_t sessionCount, long long variableCount, long long expressionCount) {
         std::ostringstream ss;
-        
         ss << "=== SESSION ANALYSIS ===" << std::endl << std::endl;
-        ss << "Total Sessions: " << sessions.size() << std::endl;
-        ss << "Total Variables: " << countTotalVariables(sessions) << std::endl;
-        ss << "Total Expressions: " << countTotalExpressions(sessions) << std::endl;
+        ss << "Total Sessions: " << sessionCount << std::endl;
+        ss << "Total Variables: " << variableCount << std::endl;
+        ss << "Total Expressions: " << expressionCount << std::endl;
         ss << std::endl;
-        
-        for (const auto& session : sessions) {
-            ss << "--- Session " << session.sessionNumber << " ---" << std::endl;
-            ss << "Variables: " << session.variableCount << std::endl;
-            ss << "Expressions: " << session.expressionCount << std::endl;
-            ss << std::endl;
-        }
-        
         return ss.str();
     }
 
+    static void appendSummaryEntry(std::string& summary, const Session& session) {
+        summary.append("--- Session ").append(std::to_string(session.sessionNumber)).append(" ---\n");
+        summary.append("Variables: ").append(std::to_string(session.variableCount)).append("\n");
+        summary.append("Expressions: ").append(std::to_string(session.expressionCount)).append("\n\n");
+    }
+
 private:
-    static std::string trim(const std::string& str) {
-        size_t first = str.find_first_not_of(" \t\r\n");
-        if (first == std::string::npos) return "";
-        size_t last = str.find_last_not_of(" \t\r\n");
-        return str.substr(first, (last - first + 1));
+    static std::vector<Session> readAll(SessionStream& stream, std::pmr::memory_resource* resource) {
+        std::vector<Session> sessions;
+        Session session = newSession(resource);
+        while (stream.next(session)) {
+            sessions.push_back(std::move(session));
+            session = newSession(resource);
+        }
+        return sessions;
     }
 };
 
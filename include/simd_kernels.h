@@ -0,0 +1,39 @@
+#ifndef SIMD_KERNELS_H
+#define SIMD_KERNELS_H
+
+#include <cstddef>
+
+// Element-wise column kernels used by batch evaluation.
+// Each kernel updates `a` in place: a[i] = a[i] op b[i] for i < n.
+// On x86-64 the arithmetic kernels use AVX2 when the CPU supports it and SSE2 otherwise;
+// other targets use plain loops. Arithmetic results are bit-identical to scalar code.
+namespace SimdKernels {
+    void add(double* a, const double* b, size_t n);
+    void sub(double* a, const double* b, size_t n);
+    void mul(double* a, const double* b, size_t n);
+    void div(double* a, const double* b, size_t n);
+    void neg(double* a, size_t n);
+    void sqrt(double* a, size_t n);
+
+    // These call libm per lane, so they match the std:: functions of the same name exactly
+    // (min and max are FunctionTable::min and max; atan2 takes y in a and x in b)
+    void pow(double* a, const double* b, size_t n);
+    void min(double* a, const double* b, size_t n);
+    void max(double* a, const double* b, size_t n);
+    void atan2(double* a, const double* b, size_t n);
+    void sin(double* a, size_t n);
+    void cos(double* a, size_t n);
+    void exp(double* a, size_t n);
+    void log(double* a, size_t n);
+
+    // FastTrig polynomials, a vector of rows at a time; bit-identical to FastTrig::sin/cos
+    void sinFast(double* a, size_t n);
+    void cosFast(double* a, size_t n);
+
+    void fill(double* a, double value, size_t n);
+
+    // Name of the instruction set selected at runtime ("avx2", "sse2" or "scalar")
+    const char* activeIsa();
+}
+
+#endif // SIMD_KERNELS_H
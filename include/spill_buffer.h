@@ -0,0 +1,66 @@
+#ifndef SPILL_BUFFER_H
+#define SPILL_BUFFER_H
+
+#include <cstdio>
+#include <ostream>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+
+// Append-only text that has to wait before it can be printed (for example, because
+// a total that is only known at the end comes first). Text accumulates in memory and
+// moves to an anonymous temporary file whenever more than `limit` bytes are waiting,
+// so memory use stays bounded however much is appended.
+class SpillBuffer {
+public:
+    static constexpr size_t DEFAULT_LIMIT = 1 << 20;
+
+    explicit SpillBuffer(size_t limit = DEFAULT_LIMIT) : limit(limit) {}
+
+    ~SpillBuffer() {
+        if (file) std::fclose(file);
+    }
+
+    SpillBuffer(const SpillBuffer&) = delete;
+    SpillBuffer& operator=(const SpillBuffer&) = delete;
+
+    void append(std::string_view text) {
+        pending.append(text);
+        if (pending.size() > limit) spill();
+    }
+
+    // Write everything appended so far to out, in order
+    void writeTo(std::ostream& out) {
+        if (file) {
+            spill();
+            std::rewind(file);
+            std::string chunk(CHUNK_SIZE, '\0');
+            size_t got;
+            while ((got = std::fread(&chunk[0], 1, chunk.size(), file)) > 0) {
+                out.write(chunk.data(), got);
+            }
+            if (std::ferror(file)) throw std::runtime_error("Error: could not read spill file");
+        }
+        out.write(pending.data(), pending.size());
+    }
+
+private:
+    static constexpr size_t CHUNK_SIZE = 64 * 1024;
+
+    void spill() {
+        if (!file) {
+            file = std::tmpfile();
+            if (!file) throw std::runtime_error("Error: could not create spill file");
+        }
+        if (std::fwrite(pending.data(), 1, pending.size(), file) != pending.size()) {
+            throw std::runtime_error("Error: could not write spill file");
+        }
+        pending.clear();
+    }
+
+    size_t limit;
+    std::string pending;
+    std::FILE* file = nullptr;
+};
+
+#endif // SPILL_BUFFER_H
@@ -0,0 +1,193 @@
+#ifndef STATS_H
+#define STATS_H
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <exception>
+#include <map>
+#include <mutex>
+#include <ostream>
+#include <string>
+#include <string_view>
+#include "categorizer.h"
+
+#if defined(__unix__) || defined(__APPLE__)
+#define STATS_GETRUSAGE 1
+#include <sys/resource.h>
+#endif
+
+// Process-wide run statistics for --stats: time and call counts per pipeline stage,
+// a latency histogram per expression category, result cache hits, error counts and peak RSS.
+//
+// Probes are free when statistics are off. Building with -DCALC_NO_STATS removes
+// them at compile time; otherwise each probe is a single branch on a flag that stays
+// false (and predicted not-taken) until enable() is called. Counters are relaxed atomics,
+// so the probes are safe to use from worker threads.
+class Stats {
+public:
+    enum Stage { READ, CACHE, PARSE, EVALUATE, CATEGORIZE, FORMAT, WRITE, STAGE_COUNT };
+
+    static constexpr size_t CATEGORY_COUNT = 4;
+    // Bucket i counts latencies in [2^i, 2^(i+1)) nanoseconds
+    static constexpr size_t HISTOGRAM_BUCKETS = 40;
+
+    static bool enabled() {
+#ifdef CALC_NO_STATS
+        return false;
+#else
+        return __builtin_expect(active.load(std::memory_order_relaxed), 0);
+#endif
+    }
+
+    // Turn statistics on; returns false when they were compiled out
+    static bool enable() {
+#ifdef CALC_NO_STATS
+        return false;
+#else
+        active.store(true, std::memory_order_relaxed);
+        return true;
+#endif
+    }
+
+    static uint64_t now() {
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now().time_since_epoch()).count();
+    }
+
+    // Adds the time between construction and destruction to a stage
+    class Timer {
+    public:
+        explicit Timer(Stage stage) : stage(stage), start(Stats::enabled() ? Stats::now() : 0) {}
+        ~Timer() {
+            if (start) Stats::addTime(stage, Stats::now() - start);
+        }
+        Timer(const Timer&) = delete;
+        Timer& operator=(const Timer&) = delete;
+
+    private:
+        Stage stage;
+        uint64_t start;
+    };
+
+    static void addTime(Stage stage, uint64_t nanoseconds) {
+        stageNanos[stage].fetch_add(nanoseconds, std::memory_order_relaxed);
+        stageCalls[stage].fetch_add(1, std::memory_order_relaxed);
+    }
+
+    // Bytes read from input (READ) or written to output (WRITE)
+    static void addBytes(Stage stage, uint64_t bytes) {
+        if (enabled()) stageBytes[stage].fetch_add(bytes, std::memory_order_relaxed);
+    }
+
+    // Total latency of one expression (evaluate, categorize, format) in its category
+    static void recordExpression(Categorizer::Category cat, uint64_t nanoseconds) {
+        size_t bucket = 0;
+        while (bucket + 1 < HISTOGRAM_BUCKETS && (nanoseconds >> (bucket + 1)) != 0) ++bucket;
+        latency[cat][bucket].fetch_add(1, std::memory_order_relaxed);
+        latencyNanos[cat].fetch_add(nanoseconds, std::memory_order_relaxed);
+    }
+
+    // Count an error by kind. Every evaluation error is a std::runtime_error whose message
+    // puts names and numbers after a ':', so the kind is the message up to its first ':'
+    // ("Undefined variable: x" -> "Undefined variable").
+    static void recordError(const std::exception& e) {
+        if (!enabled()) return;
+        std::string_view message = e.what();
+        std::string kind(message.substr(0, message.find(':')));
+        std::lock_guard<std::mutex> lock(errorMutex);
+        errors[kind]++;
+    }
+
+    // One evaluate() result cache lookup
+    static void recordCacheLookup(bool hit) {
+        (hit ? cacheHits : cacheMisses).fetch_add(1, std::memory_order_relaxed);
+    }
+
+    // Peak resident set size of the process in kilobytes, or 0 where it is not available
+    static long peakRssKb() {
+#ifdef STATS_GETRUSAGE
+        struct rusage usage;
+        if (getrusage(RUSAGE_SELF, &usage) != 0) return 0;
+#ifdef __APPLE__
+        return usage.ru_maxrss / 1024;  // macOS reports bytes, Linux and the BSDs kilobytes
+#else
+        return usage.ru_maxrss;
+#endif
+#else
+        return 0;
+#endif
+    }
+
+    static void writeJson(std::ostream& out) {
+        static const char* const STAGE_NAMES[STAGE_COUNT] = {
+            "read", "cache", "parse", "evaluate", "categorize", "format", "write"
+        };
+        static const char* const CATEGORY_NAMES[CATEGORY_COUNT] = {
+            "basic", "hex_binary", "variables", "advanced"
+        };
+
+        out << "{\n  \"enabled\": " << (enabled() ? "true" : "false") << ",\n";
+        out << "  \"peak_rss_kb\": " << peakRssKb() << ",\n";
+
+        out << "  \"stages\": {";
+        for (size_t s = 0; s < STAGE_COUNT; s++) {
+            out << (s ? ",\n" : "\n") << "    \"" << STAGE_NAMES[s] << "\": {"
+                << "\"calls\": " << stageCalls[s].load()
+                << ", \"total_ns\": " << stageNanos[s].load()
+                << ", \"bytes\": " << stageBytes[s].load() << "}";
+        }
+        out << "\n  },\n";
+
+        out << "  \"categories\": {";
+        for (size_t c = 0; c < CATEGORY_COUNT; c++) {
+            uint64_t count = 0;
+            for (size_t b = 0; b < HISTOGRAM_BUCKETS; b++) count += latency[c][b].load();
+            out << (c ? ",\n" : "\n") << "    \"" << CATEGORY_NAMES[c] << "\": {"
+                << "\"count\": " << count
+                << ", \"total_ns\": " << latencyNanos[c].load()
+                << ", \"histogram\": [";
+            bool first = true;
+            for (size_t b = 0; b < HISTOGRAM_BUCKETS; b++) {
+                uint64_t n = latency[c][b].load();
+                if (n == 0) continue;
+                out << (first ? "" : ", ") << "{\"lt_ns\": " << (uint64_t(1) << (b + 1)) << ", \"count\": " << n << "}";
+                first = false;
+            }
+            out << "]}";
+        }
+        out << "\n  },\n";
+
+        out << "  \"cache\": {\"hits\": " << cacheHits.load() << ", \"misses\": " << cacheMisses.load() << "},\n";
+
+        out << "  \"errors\": {";
+        {
+            std::lock_guard<std::mutex> lock(errorMutex);
+            bool first = true;
+            for (const auto& [kind, count] : errors) {
+                out << (first ? "" : ", ") << "\"";
+                for (char c : kind) {
+                    if (c == '"' || c == '\\') out << '\\';
+                    out << c;
+                }
+                out << "\": " << count;
+                first = false;
+            }
+        }
+        out << "}\n}\n";
+    }
+
+private:
+    static inline std::atomic<bool> active{false};
+    static inline std::atomic<uint64_t> stageNanos[STAGE_COUNT];
+    static inline std::atomic<uint64_t> stageCalls[STAGE_COUNT];
+    static inline std::atomic<uint64_t> stageBytes[STAGE_COUNT];
+    static inline std::atomic<uint64_t> latency[CATEGORY_COUNT][HISTOGRAM_BUCKETS];
+    static inline std::atomic<uint64_t> latencyNanos[CATEGORY_COUNT];
+    static inline std::atomic<uint64_t> cacheHits;
+    static inline std::atomic<uint64_t> cacheMisses;
+    static inline std::mutex errorMutex;
+    static inline std::map<std::string, uint64_t> errors;
+};
+
+#endif // STATS_H
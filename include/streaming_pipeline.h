@@ -0,0 +1,173 @@
+#ifndef STREAMING_PIPELINE_H
+#define STREAMING_PIPELINE_H
+
+#include <array>
+#include <cstdio>
+#include <fstream>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <thread>
+#include "bounded_queue.h"
+#include "categorizer.h"
+#include "evaluator.h"
+#include "output_sink.h"
+#include "expression_processor.h"
+#include "file_reader.h"
+#include "result_writer.h"
+#include "stats.h"
+#include "text_utils.h"
+
+// Bounded-memory alternative to FileReader -> ExpressionProcessor -> ResultWriter.
+// Reading, evaluation and writing run as three stages joined by bounded queues,
+// so memory use does not grow with the input. Each category is spilled to its own
+// temporary segment file next to the output, and the segments are concatenated in
+// category order at the end, giving the same output as the in-memory path.
+class StreamingPipeline {
+public:
+    // Process inputFile into outputFile; returns the number of expressions read
+    static size_t run(const std::string& inputFile,
+                      const std::string& outputFile,
+                      Evaluator& evaluator,
+                      bool asyncWrites = false,
+                      size_t queueCapacity = 1024) {
+        // Lines are views into the mapping, so nothing is copied before evaluation; the
+        // mapping is read front to back and its pages can be dropped once passed
+        MappedFile input = FileReader::openInput(inputFile);
+
+        std::array<std::fstream, CATEGORY_COUNT> segments;
+        for (size_t i = 0; i < CATEGORY_COUNT; i++) {
+            segments[i].open(segmentPath(outputFile, i),
+                             std::ios::in | std::ios::out | std::ios::trunc | std::ios::binary);
+            if (!segments[i]) {
+                removeSegments(outputFile);
+                throw std::runtime_error("Error: could not create spill segment: " + segmentPath(outputFile, i));
+            }
+        }
+
+        BoundedQueue<std::string_view> lines(queueCapacity);
+        BoundedQueue<CategorizedLine> results(queueCapacity);
+        size_t expressionCount = 0;
+        std::array<size_t, CATEGORY_COUNT> itemCounts{};
+        std::thread reader;
+        std::thread writer;
+        StageGuard guard{lines, results, reader, writer};
+
+        // Stage 1: split the mapping into trimmed lines
+        reader = std::thread([&] {
+            std::string_view text = input.contents();
+            std::string_view line;
+            size_t pos = 0;
+            while (true) {
+                {
+                    Stats::Timer timer(Stats::READ);
+                    if (!TextUtils::nextLine(text, pos, line)) break;
+                }
+                Stats::addBytes(Stats::READ, line.size() + 1);
+                line = TextUtils::trim(line);
+                if (line.empty() || TextUtils::isSessionSeparator(line)) continue;
+                if (!lines.push(line)) break;
+                expressionCount++;
+            }
+            lines.close();
+        });
+
+        // Stage 3: spill each result to its category segment
+        writer = std::thread([&] {
+            CategorizedLine result;
+            while (results.pop(result)) {
+                ResultWriter::writeItem(segments[result.category], result.output);
+                itemCounts[result.category]++;
+            }
+        });
+
+        // Stage 2: evaluate, format and categorize (in input order, so variables behave as usual)
+        std::string_view line;
+        CategorizedLine result;
+        try {
+            while (lines.pop(line)) {
+                if (ExpressionProcessor::processExpression(line, evaluator, result.category, result.output)) {
+                    results.push(std::move(result));
+                }
+            }
+        } catch (...) {
+            guard.stop();
+            removeSegments(outputFile);
+            throw;
+        }
+        guard.stop();
+
+        try {
+            concatenate(outputFile, segments, itemCounts, asyncWrites);
+        } catch (...) {
+            removeSegments(outputFile);
+            throw;
+        }
+        removeSegments(outputFile);
+        return expressionCount;
+    }
+
+private:
+    static constexpr size_t CATEGORY_COUNT = 4;
+
+    struct CategorizedLine {
+        Categorizer::Category category = Categorizer::BASIC_CALC;
+        std::string output;
+    };
+
+    // Closes both queues and joins the stage threads, on success and when stage 2
+    // throws; a closed queue also releases the reader if it is blocked on a full one
+    struct StageGuard {
+        BoundedQueue<std::string_view>& lines;
+        BoundedQueue<CategorizedLine>& results;
+        std::thread& reader;
+        std::thread& writer;
+
+        void stop() {
+            lines.close();
+            results.close();
+            if (reader.joinable()) reader.join();
+            if (writer.joinable()) writer.join();
+        }
+
+        ~StageGuard() { stop(); }
+    };
+
+    static std::string segmentPath(const std::string& outputFile, size_t index) {
+        return outputFile + ".seg" + std::to_string(index) + ".tmp";
+    }
+
+    static void removeSegments(const std::string& outputFile) {
+        for (size_t i = 0; i < CATEGORY_COUNT; i++) {
+            std::remove(segmentPath(outputFile, i).c_str());
+        }
+    }
+
+    static void concatenate(const std::string& outputFile,
+                            std::array<std::fstream, CATEGORY_COUNT>& segments,
+                            const std::array<size_t, CATEGORY_COUNT>& itemCounts,
+                            bool asyncWrites) {
+        OutputSink output(outputFile, asyncWrites);
+        if (!output.isOpen()) {
+            throw std::runtime_error("Error: could not open output file: " + outputFile);
+        }
+
+        const Categorizer::Category order[CATEGORY_COUNT] = {
+            Categorizer::BASIC_CALC, Categorizer::HEX_BINARY,
+            Categorizer::VARIABLES, Categorizer::ADVANCED
+        };
+        for (Categorizer::Category cat : order) {
+            std::fstream& segment = segments[cat];
+            if (!segment) {
+                throw std::runtime_error("Error: could not write spill segment for " + outputFile);
+            }
+            if (itemCounts[cat] == 0) continue;
+            segment.flush();
+            segment.seekg(0);
+            ResultWriter::writeSegment(output, cat, segment);
+        }
+        output.close();
+    }
+};
+
+#endif // STREAMING_PIPELINE_H
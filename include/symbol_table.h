@@ -0,0 +1,121 @@
+#ifndef SYMBOL_TABLE_H
+#define SYMBOL_TABLE_H
+
+#include <algorithm>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// Interns variable names into dense integer slots.
+// Lookups hash the name in place, so resolving a known name never allocates.
+class SymbolTable {
+public:
+    SymbolTable() : buckets(16, EMPTY) {}
+
+    // Slot of a name, or -1 if it has never been interned
+    int find(std::string_view name) const {
+        size_t mask = buckets.size() - 1;
+        for (size_t i = hash(name) & mask; ; i = (i + 1) & mask) {
+            int slot = buckets[i];
+            if (slot == EMPTY) return -1;
+            if (names[slot] == name) return slot;
+        }
+    }
+
+    // Slot of a name, assigning the next free slot on first use
+    int intern(std::string_view name) {
+        int slot = find(name);
+        if (slot >= 0) return slot;
+
+        if ((count + 1) * 2 > buckets.size()) grow();
+        slot = static_cast<int>(count);
+        // Reuse a name string left over from before clear()
+        if (count < names.size()) names[count].assign(name);
+        else names.emplace_back(name);
+        count++;
+        insert(slot);
+        return slot;
+    }
+
+    // Forget every name, keeping all storage for reuse
+    void clear() {
+        std::fill(buckets.begin(), buckets.end(), EMPTY);
+        count = 0;
+    }
+
+    const std::string& name(int slot) const {
+        return names[slot];
+    }
+
+    size_t size() const {
+        return count;
+    }
+
+private:
+    static constexpr int EMPTY = -1;
+
+    // FNV-1a
+    static size_t hash(std::string_view name) {
+        size_t h = 14695981039346656037ULL;
+        for (char c : name) {
+            h ^= static_cast<unsigned char>(c);
+            h *= 1099511628211ULL;
+        }
+        return h;
+    }
+
+    void insert(int slot) {
+        size_t mask = buckets.size() - 1;
+        size_t i = hash(names[slot]) & mask;
+        while (buckets[i] != EMPTY) i = (i + 1) & mask;
+        buckets[i] = slot;
+    }
+
+    void grow() {
+        buckets.assign(buckets.size() * 2, EMPTY);
+        for (size_t slot = 0; slot < count; slot++) {
+            insert(static_cast<int>(slot));
+        }
+    }
+
+    std::vector<std::string> names;  // slot -> name (entries past count are spare)
+    std::vector<int> buckets;        // open-addressing table of slots
+    size_t count = 0;                // interned names
+};
+
+// Flat variable storage indexed by SymbolTable slot
+struct Environment {
+    std::vector<double> values;
+    std::vector<unsigned char> defined;
+    std::vector<uint64_t> versions;  // bumped on every store, so cached results can tell a slot changed
+
+    // Make room for every slot in a table of the given size
+    void reserveSlots(size_t count) {
+        if (values.size() < count) {
+            values.resize(count, 0.0);
+            defined.resize(count, 0);
+            versions.resize(count, 0);
+        }
+    }
+
+    // Drop every slot, keeping the capacity
+    void clear() {
+        values.clear();
+        defined.clear();
+        versions.clear();
+    }
+
+    void set(int slot, double value) {
+        values[slot] = value;
+        stored(slot);
+    }
+
+    // Record that values[slot] was written
+    void stored(int slot) {
+        defined[slot] = 1;
+        versions[slot]++;
+    }
+};
+
+#endif // SYMBOL_TABLE_H
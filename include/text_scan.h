@@ -0,0 +1,91 @@
+#ifndef TEXT_SCAN_H
+#define TEXT_SCAN_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
+
+// Character classes and run scanning for the text front end: line splitting, trimming
+// and the Parser's tokenizer. Classes are those of the "C" locale the parser runs in,
+// and bytes >= 0x80 belong to none of them.
+//
+// Runs are found 32 bytes at a time with AVX2 when the CPU supports it and 16 at a
+// time with SSE2 otherwise (plain loops on other targets). Scans never read outside
+// the given text. Most runs inside an expression are a few bytes long, shorter than
+// a call into the vector code costs, so the inline wrappers look up their first
+// SHORT_RUN bytes in a table and only hand longer runs to the vector scans.
+namespace TextScan {
+
+    enum CharClass : uint8_t {
+        SPACE = 1,          // isspace(): ' ', '\t', '\n', '\v', '\f', '\r'
+        LINE_SPACE = 2,     // what trimming a line removes: ' ', '\t', '\r', '\n'
+        DIGIT = 4,          // 0-9
+        HEX_DIGIT = 8,      // 0-9, a-f, A-F
+        ALPHA = 16,         // a-z, A-Z
+        IDENTIFIER = 32,    // ALPHA, DIGIT or '_' (the characters of a variable name)
+        DECIMAL = 64,       // DIGIT or '.' (the characters of a decimal literal)
+        BINARY_DIGIT = 128  // 0, 1
+    };
+
+    struct ClassTable {
+        uint8_t of[256] = {};
+
+        constexpr ClassTable() {
+            for (int c = '\t'; c <= '\r'; c++) of[c] |= SPACE;
+            of[static_cast<unsigned char>(' ')] |= SPACE | LINE_SPACE;
+            for (char c : {'\t', '\r', '\n'}) of[static_cast<unsigned char>(c)] |= LINE_SPACE;
+            for (int c = '0'; c <= '9'; c++) of[c] |= DIGIT | HEX_DIGIT | IDENTIFIER | DECIMAL;
+            for (int c = 'a'; c <= 'z'; c++) of[c] |= ALPHA | IDENTIFIER | (c <= 'f' ? HEX_DIGIT : 0);
+            for (int c = 'A'; c <= 'Z'; c++) of[c] |= ALPHA | IDENTIFIER | (c <= 'F' ? HEX_DIGIT : 0);
+            of[static_cast<unsigned char>('_')] |= IDENTIFIER;
+            of[static_cast<unsigned char>('.')] |= DECIMAL;
+            of[static_cast<unsigned char>('0')] |= BINARY_DIGIT;
+            of[static_cast<unsigned char>('1')] |= BINARY_DIGIT;
+        }
+    };
+
+    inline constexpr ClassTable CLASSES{};
+
+    constexpr bool is(char c, CharClass cls) {
+        return (CLASSES.of[static_cast<unsigned char>(c)] & cls) != 0;
+    }
+
+    // Vector scans behind the inline wrappers below
+    size_t skipRun(const char* data, size_t size, size_t pos, CharClass cls);
+    size_t skipRunBack(const char* data, size_t end, CharClass cls);
+    size_t findByte(const char* data, size_t size, size_t pos, char byte);
+
+    // Runs up to this long are scanned inline, a byte at a time
+    constexpr size_t SHORT_RUN = 16;
+
+    // First position at or after pos whose character is not in cls (text.size() if none)
+    inline size_t skip(std::string_view text, size_t pos, CharClass cls) {
+        if (pos >= text.size()) return pos;
+        size_t limit = text.size() - pos < SHORT_RUN ? text.size() : pos + SHORT_RUN;
+        while (pos < limit && is(text[pos], cls)) ++pos;
+        if (pos < limit || pos == text.size()) return pos;
+        return skipRun(text.data(), text.size(), pos, cls);
+    }
+
+    // Start of the run of cls characters that ends at end (end itself if there is none)
+    inline size_t skipBack(std::string_view text, size_t end, CharClass cls) {
+        size_t limit = end < SHORT_RUN ? 0 : end - SHORT_RUN;
+        while (end > limit && is(text[end - 1], cls)) --end;
+        if (end > limit || end == 0) return end;
+        return skipRunBack(text.data(), end, cls);
+    }
+
+    // Position of the first `byte` at or after pos (text.size() if none)
+    inline size_t find(std::string_view text, size_t pos, char byte) {
+        if (pos >= text.size()) return text.size();
+        return findByte(text.data(), text.size(), pos, byte);
+    }
+
+    // Name of the instruction set selected at runtime ("avx2", "sse2" or "scalar")
+    const char* activeIsa();
+
+    // For tests: false makes an AVX2 CPU use the SSE2 scans (no effect on other CPUs)
+    void setAvx2Enabled(bool enabled);
+}
+
+#endif // TEXT_SCAN_H
@@ -0,0 +1,34 @@
+#ifndef TEXT_UTILS_H
+#define TEXT_UTILS_H
+
+#include <string_view>
+#include "text_scan.h"
+
+// Allocation-free helpers shared by the line-oriented readers
+namespace TextUtils {
+
+    // Trim surrounding whitespace (' ', '\t', '\r', '\n') without copying
+    inline std::string_view trim(std::string_view str) {
+        size_t first = TextScan::skip(str, 0, TextScan::LINE_SPACE);
+        if (first == str.size()) return std::string_view();
+        size_t end = TextScan::skipBack(str, str.size(), TextScan::LINE_SPACE);
+        return str.substr(first, end - first);
+    }
+
+    // Return the next line starting at pos (without its '\n') and advance pos past it.
+    // Returns false once the text is exhausted.
+    inline bool nextLine(std::string_view text, size_t& pos, std::string_view& line) {
+        if (pos >= text.size()) return false;
+        size_t end = TextScan::find(text, pos, '\n');
+        line = text.substr(pos, end - pos);
+        pos = end + 1;
+        return true;
+    }
+
+    // Session header line
+    inline bool isSessionSeparator(std::string_view line) {
+        return line == "----";
+    }
+}
+
+#endif // TEXT_UTILS_H
@@ -0,0 +1,119 @@
+#ifndef WORKLOAD_GENERATOR_H
+#define WORKLOAD_GENERATOR_H
+
+#include <cstdint>
+#include <cstdio>
+#include <random>
+#include <string>
+#include <vector>
+
+// Shape of a synthetic workload; the same options and seed always give the same text
+struct WorkloadOptions {
+    size_t expressions = 100000;  // calculator input lines (assignments included)
+    size_t sessions = 10000;      // session blocks for session_analyzer
+    int length = 8;               // operands per expression, before nesting
+    int depth = 2;                // maximum parenthesis / function nesting
+    int variables = 8;            // distinct variable names
+    double hexShare = 0.1;        // share of literals written in hex or binary
+    double functionShare = 0.1;   // share of operands wrapped in sin() / cos()
+    uint64_t seed = 42;
+};
+
+// Generates calculator input and session files with a controlled mix of features
+class WorkloadGenerator {
+public:
+    explicit WorkloadGenerator(const WorkloadOptions& options)
+        : options(options), random(options.seed) {}
+
+    // One expression per line. The variables are defined first, then redefined every
+    // 16 lines so assignments stay part of the mix.
+    std::string calculatorInput() {
+        std::string text;
+        for (int v = 0; v < options.variables; v++) text += assignment(v) + "\n";
+        for (size_t i = 0; i < options.expressions; i++) {
+            if (options.variables > 0 && i % 16 == 15) {
+                text += assignment(static_cast<int>(pick(options.variables))) + "\n";
+            } else {
+                text += expression(options.depth, options.length) + "\n";
+            }
+        }
+        return text;
+    }
+
+    // Session blocks: separator, variable definitions, one expression
+    std::string sessionInput() {
+        std::string text;
+        for (size_t s = 0; s < options.sessions; s++) {
+            text += "----\n";
+            for (int v = 0; v < options.variables; v++) text += assignment(v) + "\n";
+            text += expression(options.depth, options.length) + "\n\n";
+        }
+        return text;
+    }
+
+    // A single expression with the configured shape
+    std::string expression(int depth, int operands) {
+        static const char OPERATORS[] = {'+', '-', '*', '/', '+', '-', '*', '^'};
+        std::string text = operand(depth, operands);
+        for (int i = 1; i < operands; i++) {
+            char op = OPERATORS[pick(sizeof(OPERATORS))];
+            text += ' ';
+            text += op;
+            text += ' ';
+            // Keep powers small so results stay finite
+            text += (op == '^') ? std::to_string(1 + pick(3)) : operand(depth, operands);
+        }
+        return text;
+    }
+
+private:
+    std::string operand(int depth, int operands) {
+        if (depth > 0 && chance(options.functionShare)) {
+            return (chance(0.5) ? "sin(" : "cos(") + expression(depth - 1, operands / 2 + 1) + ")";
+        }
+        if (depth > 0 && chance(0.15)) {
+            return "(" + expression(depth - 1, operands / 2 + 1) + ")";
+        }
+        if (options.variables > 0 && chance(0.3)) {
+            return variableName(static_cast<int>(pick(options.variables)));
+        }
+        return literal();
+    }
+
+    std::string literal() {
+        uint64_t value = 1 + pick(999);
+        if (chance(options.hexShare)) {
+            if (chance(0.5)) {
+                char buffer[32];
+                snprintf(buffer, sizeof(buffer), "0x%llX", static_cast<unsigned long long>(value));
+                return buffer;
+            }
+            std::string bits;
+            for (uint64_t v = value; v; v >>= 1) bits.insert(bits.begin(), char('0' + (v & 1)));
+            return bits + "b";
+        }
+        if (chance(0.3)) return std::to_string(value) + "." + std::to_string(pick(100));
+        return std::to_string(value);
+    }
+
+    std::string assignment(int variable) {
+        return variableName(variable) + " = " + literal();
+    }
+
+    static std::string variableName(int variable) {
+        return "v" + std::to_string(variable);
+    }
+
+    uint64_t pick(uint64_t bound) {
+        return std::uniform_int_distribution<uint64_t>(0, bound - 1)(random);
+    }
+
+    bool chance(double probability) {
+        return std::uniform_real_distribution<double>(0.0, 1.0)(random) < probability;
+    }
+
+    WorkloadOptions options;
+    std::mt19937_64 random;
+};
+
+#endif // WORKLOAD_GENERATOR_H
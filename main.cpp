@@ -4,37 +4,119 @@
 #include "include/file_reader.h"
 #include "include/expression_processor.h"
 #include "include/result_writer.h"
+#include "include/session_binary.h"
+#include "include/streaming_pipeline.h"
+#include "include/stats.h"
 
 void printUsage(const char* programName) {
-    std::cerr << "Usage: " << programName << " <inputFileName>" << std::endl;
+    std::cerr << "Usage: " << programName << " [--stream] [--async-write] [--dump-opt] [--stats] [--trig exact|fast] [--no-jit] [-o outputFile] <inputFileName>" << std::endl;
     std::cerr << "Example: " << programName << " input.txt" << std::endl;
+    std::cerr << "  The input may also be a binary session file written by session_convert" << std::endl;
+    std::cerr << "  --stream       process the input in constant memory (for inputs larger than RAM)" << std::endl;
+    std::cerr << "  --async-write  write results from a background thread" << std::endl;
+    std::cerr << "  --dump-opt     print each expression tree before and after optimization to stderr" << std::endl;
+    std::cerr << "  --stats        print per-stage timings, latency histograms and error counts as JSON to stderr" << std::endl;
+    std::cerr << "  --trig MODE    sin/cos implementation: exact (libm, default) or fast (polynomial, within 2.5 ulp)" << std::endl;
+    std::cerr << "  --no-jit       always interpret compiled programs, never translate them to native code" << std::endl;
+    std::cerr << "  -o, --output   output file (default: output.txt)" << std::endl;
 }
 
 int main(int argc, char* argv[]) {
     try {
         // Check command line arguments
-        if (argc < 2) {
+        std::string inputFile;
+        std::string outputFile = "output.txt";
+        bool streaming = false;
+        bool asyncWrites = false;
+        bool dumpOptimizer = false;
+        bool stats = false;
+        TrigAccuracy trig = TrigAccuracy::EXACT;
+        bool jit = true;
+        for (int i = 1; i < argc; i++) {
+            std::string arg = argv[i];
+            if (arg == "--stream") {
+                streaming = true;
+            } else if (arg == "--async-write") {
+                asyncWrites = true;
+            } else if (arg == "--dump-opt") {
+                dumpOptimizer = true;
+            } else if (arg == "--stats") {
+                stats = true;
+            } else if (arg == "--trig") {
+                std::string mode = i + 1 < argc ? argv[++i] : "";
+                if (mode != "exact" && mode != "fast") {
+                    printUsage(argv[0]);
+                    return 1;
+                }
+                trig = mode == "fast" ? TrigAccuracy::FAST : TrigAccuracy::EXACT;
+            } else if (arg == "--no-jit") {
+                jit = false;
+            } else if (arg == "-o" || arg == "--output") {
+                if (i + 1 >= argc) {
+                    printUsage(argv[0]);
+                    return 1;
+                }
+                outputFile = argv[++i];
+            } else {
+                inputFile = arg;
+            }
+        }
+        if (inputFile.empty()) {
             printUsage(argv[0]);
             return 1;
         }
 
-        std::string inputFile = argv[1];
-        std::string outputFile = "output.txt";
+        if (stats) Stats::enable();
 
         std::cout << "Reading from: " << inputFile << std::endl;
 
-        // Step 1: Read all expressions from input file
-        std::vector<std::string> expressions = FileReader::readExpressions(inputFile);
-        std::cout << "Found " << expressions.size() << " expressions" << std::endl;
-
-        // Step 2: Process and evaluate expressions
         Evaluator evaluator;
-        CategoryResults results = ExpressionProcessor::processExpressions(expressions, evaluator);
+        if (dumpOptimizer) evaluator.setOptimizationDump(&std::cerr);
+        evaluator.setTrigAccuracy(trig);
+        evaluator.setJitEnabled(jit);
+
+        bool binaryInput = SessionBinary::isBinaryFile(inputFile);
+        if (streaming && binaryInput) {
+            throw std::runtime_error("--stream reads text input; " + inputFile + " is a binary session file");
+        }
+        if (trig == TrigAccuracy::FAST && binaryInput) {
+            // Its programs were compiled with libm's sin and cos
+            throw std::runtime_error("--trig fast needs text input; " + inputFile + " is a binary session file");
+        }
+
+        if (streaming) {
+            size_t count = StreamingPipeline::run(inputFile, outputFile, evaluator, asyncWrites);
+            std::cout << "Found " << count << " expressions" << std::endl;
+            std::cout << "Results written to: " << outputFile << std::endl;
+            if (stats) Stats::writeJson(std::cerr);
+            return 0;
+        }
+
+        CategoryResults results;
+        if (binaryInput) {
+            // Precompiled programs: nothing to parse, lines run straight from the mapping
+            SessionBinary binary;
+            {
+                Stats::Timer timer(Stats::READ);
+                binary.load(inputFile);
+            }
+            std::cout << "Found " << binary.expressionCount() << " expressions" << std::endl;
+            results = ExpressionProcessor::processBinary(binary, evaluator);
+        } else {
+            // Step 1: Map the input file; expressions are views into the mapping
+            MappedFile input = FileReader::openInput(inputFile);
+            std::vector<std::string_view> expressions = FileReader::readExpressions(input);
+            std::cout << "Found " << expressions.size() << " expressions" << std::endl;
+
+            // Step 2: Process and evaluate expressions
+            results = ExpressionProcessor::processExpressions(expressions, evaluator);
+        }
 
         // Step 3: Write results to output file
-        ResultWriter::writeResults(outputFile, results);
+        ResultWriter::writeResults(outputFile, results, asyncWrites);
 
         std::cout << "Results written to: " << outputFile << std::endl;
+        if (stats) Stats::writeJson(std::cerr);
         return 0;
     } catch (const std::exception& e) {
         std::cerr << "Error: " << e.what() << std::endl;
@@ -1,105 +1,376 @@
 #include <iostream>
 #include <iomanip>
+#include <algorithm>
+#include <charconv>
+#include <cstddef>
+#include <memory>
+#include <memory_resource>
+#include <optional>
+#include "include/session_binary.h"
 #include "include/session_parser.h"
+#include "include/spill_buffer.h"
 #include "include/formatter.h"
+#include "include/categorizer.h"
 #include "include/evaluator.h"
+#include "include/thread_pool.h"
+#include "include/stats.h"
+
+// Sessions handed to a worker at a time when running with --jobs
+const size_t SESSIONS_PER_TASK = 64;
+
+// Result of evaluating one session, kept until it can be printed in order
+struct SessionOutcome {
+    bool ok = true;
+    std::string report;  // "Session N : OK" line or error details
+    std::string block;   // session block: header, variable definitions, expression results
+};
+
+// State reused from one session to the next. The evaluator is reset rather than rebuilt,
+// and per-session temporaries come from a monotonic arena over a fixed buffer that is
+// rewound between sessions, so a typical session needs no heap allocation for either.
+struct SessionWorkspace {
+    Evaluator evaluator;
+    CompiledExpr program;     // binary input: program of the line being run
+    std::vector<int> slots;   // binary input: the session's scope slots in evaluator
+    alignas(std::max_align_t) std::byte buffer[16 * 1024];
+    std::pmr::monotonic_buffer_resource arena{buffer, sizeof(buffer)};
+};
+
+void appendNumber(std::string& text, int value) {
+    char digits[16];
+    text.append(digits, std::to_chars(digits, digits + sizeof(digits), value).ptr - digits);
+}
+
+// "<kind> error in session N: '<line>' -> <message>\n"
+void appendError(std::string& report, const char* kind, int sessionNumber,
+                 std::string_view line, const char* message) {
+    report.append(kind).append(" error in session ");
+    appendNumber(report, sessionNumber);
+    report.append(": '").append(line).append("' -> ").append(message).append("\n");
+}
+
+// Evaluate line `index` of a session (its variables, then its expression): from the
+// text, or from the precompiled program when the sessions came from a binary file.
+// Functions from earlier sessions are gone here, so their calls fail as they do in text.
+double evaluateLine(const Session& session, size_t index, std::string_view text,
+                    SessionWorkspace& workspace, const SessionBinary* binary) {
+    if (!binary) return workspace.evaluator.evaluate(text);
+    size_t line = session.firstLine + index;
+    std::string_view error = binary->sessionError(line);
+    if (!error.empty()) throw std::runtime_error(std::string(error));
+    return binary->run(line, workspace.evaluator, workspace.slots, workspace.program);
+}
+
+// ExprFeature bits of the line evaluateLine() last ran
+unsigned lineFeatures(const Session& session, size_t index, SessionWorkspace& workspace,
+                      const SessionBinary* binary) {
+    if (!binary) return workspace.evaluator.lastFeatures();
+    return binary->lineFeatures(session.firstLine + index);
+}
+
+// Evaluate one session with a reset evaluator so variables don't leak between sessions
+SessionOutcome analyzeSession(const Session& session, SessionWorkspace& workspace,
+                              const SessionBinary* binary) {
+    workspace.arena.release();
+    workspace.evaluator.reset();
+    Evaluator& evaluator = workspace.evaluator;
+    if (binary && session.variableCount + session.expressionCount > 0) {
+        binary->bindScope(binary->lineScope(session.firstLine), evaluator, workspace.slots);
+    }
+
+    SessionOutcome outcome;
+    std::pmr::string exprLines(&workspace.arena);  // formatted expression results, one per line
+
+    // First, evaluate variable definitions (they may set state)
+    size_t index = 0;
+    for (const auto& varLine : session.variables) {
+        try {
+            evaluateLine(session, index++, varLine, workspace, binary);
+        } catch (const std::exception& e) {
+            Stats::recordError(e);
+            outcome.ok = false;
+            appendError(outcome.report, "Variable", session.sessionNumber, varLine, e.what());
+            break;
+        }
+    }
+
+    // If variables OK, evaluate expressions
+    if (outcome.ok) {
+        for (const auto& expr : session.expressions) {
+            uint64_t start = Stats::enabled() ? Stats::now() : 0;
+            try {
+                double val = evaluateLine(session, index, expr, workspace, binary);
+                {
+                    Stats::Timer timer(Stats::FORMAT);
+                    char value[Formatter::RESULT_BUFFER_SIZE];
+                    size_t length = Formatter::formatValue(value, val, Formatter::hasDecimalPoint(expr));
+                    exprLines.append("  ").append(expr).append(" = ").append(value, length).append("\n");
+                }
+                // The analyzer does not group by category; only --stats needs it
+                if (start) {
+                    Categorizer::Category cat;
+                    {
+                        Stats::Timer timer(Stats::CATEGORIZE);
+                        cat = Categorizer::categorize(lineFeatures(session, index, workspace, binary));
+                    }
+                    Stats::recordExpression(cat, Stats::now() - start);
+                }
+            } catch (const std::exception& e) {
+                Stats::recordError(e);
+                if (start) {
+                    Stats::recordExpression(Categorizer::categorize(lineFeatures(session, index, workspace, binary)),
+                                            Stats::now() - start);
+                }
+                outcome.ok = false;
+                exprLines.append("  ").append(expr).append(" => Error: ").append(e.what()).append("\n");
+                appendError(outcome.report, "Expression", session.sessionNumber, expr, e.what());
+                break;
+            }
+        }
+    }
+
+    if (outcome.ok) {
+        outcome.report.append("Session ");
+        appendNumber(outcome.report, session.sessionNumber);
+        outcome.report.append(" : OK\n");
+    }
+
+    // Build the session block using structured format, sized up front
+    size_t variablesSize = 0;
+    for (const auto& v : session.variables) variablesSize += v.size() + 3;
+
+    std::string& block = outcome.block;
+    block.reserve(64 + variablesSize + exprLines.size());
+    block.append("----\nSession ");
+    appendNumber(block, session.sessionNumber);
+    block.append("\n");
+
+    if (!session.variables.empty()) {
+        block.append("Variables:\n");
+        for (const auto& v : session.variables) {
+            block.append("  ").append(v).append("\n");
+        }
+    }
+
+    if (!exprLines.empty()) {
+        block.append("Expression:\n").append(exprLines);
+    }
+    block.append("\n");
+
+    return outcome;
+}
+
+// Where the analyzer's sessions come from: streamed from text, or the records of a
+// binary session file
+class SessionSource {
+public:
+    explicit SessionSource(const std::string& filename) : stream(filename) {}
+    explicit SessionSource(const SessionBinary& binary) : binary(&binary) {}
+
+    bool next(Session& session) {
+        if (!binary) return stream->next(session);
+        if (nextIndex == binary->sessionCount()) return false;
+        binary->session(nextIndex++, session);
+        return true;
+    }
+
+    size_t bytesRead() const { return stream ? stream->bytesRead() : 0; }
+
+private:
+    std::optional<SessionStream> stream;
+    const SessionBinary* binary = nullptr;
+    size_t nextIndex = 0;
+};
+
+// Sessions read and evaluated together. Lines come from the batch's arena, which is
+// rewound when the batch is refilled, so memory use depends on the batch size only.
+struct SessionBatch {
+    std::pmr::monotonic_buffer_resource arena;
+    std::vector<Session> sessions;
+    std::vector<SessionOutcome> outcomes;
+};
+
+// Output that can only be printed once every session has been seen, because the
+// totals in front of it are only known then
+struct PendingOutput {
+    size_t sessions = 0;
+    long long variables = 0;
+    long long expressions = 0;
+    size_t correct = 0;
+    SpillBuffer summary;  // "--- Session N ---" entries
+    SpillBuffer blocks;   // session blocks
+    SpillBuffer reports;  // per-session reports
+};
+
+// Read up to `size` sessions into batch, adding them to the summary; false if there were none
+bool fillBatch(SessionBatch& batch, SessionSource& source, size_t size, PendingOutput& output) {
+    Stats::Timer timer(Stats::READ);
+    batch.sessions.clear();
+    batch.arena.release();
+    std::string entries;
+    while (batch.sessions.size() < size) {
+        Session session = SessionParser::newSession(&batch.arena);
+        if (!source.next(session)) break;
+        output.sessions++;
+        output.variables += session.variableCount;
+        output.expressions += session.expressionCount;
+        SessionParser::appendSummaryEntry(entries, session);
+        batch.sessions.push_back(std::move(session));
+    }
+    output.summary.append(entries);
+    batch.outcomes.resize(batch.sessions.size());
+    return !batch.sessions.empty();
+}
+
+void evaluateRange(SessionBatch& batch, size_t first, size_t last, SessionWorkspace& workspace,
+                   const SessionBinary* binary, TrigAccuracy trig, bool jit) {
+    workspace.evaluator.setTrigAccuracy(trig);
+    workspace.evaluator.setJitEnabled(jit);
+    for (size_t i = first; i < last; i++) {
+        batch.outcomes[i] = analyzeSession(batch.sessions[i], workspace, binary);
+    }
+}
+
+void collectOutcomes(SessionBatch& batch, PendingOutput& output) {
+    Stats::Timer timer(Stats::WRITE);
+    for (SessionOutcome& outcome : batch.outcomes) {
+        if (outcome.ok) output.correct++;
+        output.blocks.append(outcome.block);
+        outcome.report.push_back('\n');
+        output.reports.append(outcome.report);
+        Stats::addBytes(Stats::WRITE, outcome.block.size() + outcome.report.size());
+    }
+}
+
+void printUsage(const char* programName) {
+    std::cerr << "Usage: " << programName << " [--jobs N] [--stats] [--trig exact|fast] [--no-jit] [sessionsFile]" << std::endl;
+    std::cerr << "  sessionsFile may also be a binary session file written by session_convert," << std::endl;
+    std::cerr << "  or - to read sessions from standard input" << std::endl;
+    std::cerr << "  --trig MODE  sin/cos implementation: exact (libm, default) or fast (polynomial, within 2.5 ulp)" << std::endl;
+    std::cerr << "  --no-jit     always interpret compiled programs, never translate them to native code" << std::endl;
+}
 
 int main(int argc, char* argv[]) {
     try {
     // Use provided filename or default
-    std::string filename = (argc > 1) ? argv[1] : "sessions.txt";
+    std::string filename = "sessions.txt";
+    size_t jobs = 1;
+    bool stats = false;
+    TrigAccuracy trig = TrigAccuracy::EXACT;
+    bool jit = true;
+
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        if (arg == "--jobs") {
+            if (i + 1 >= argc) {
+                printUsage(argv[0]);
+                return 1;
+            }
+            // --jobs 0 means one worker per hardware thread
+            jobs = std::stoul(argv[++i]);
+            if (jobs == 0) jobs = ThreadPool::defaultThreadCount();
+        } else if (arg == "--stats") {
+            stats = true;
+        } else if (arg == "--trig") {
+            std::string mode = i + 1 < argc ? argv[++i] : "";
+            if (mode != "exact" && mode != "fast") {
+                printUsage(argv[0]);
+                return 1;
+            }
+            trig = mode == "fast" ? TrigAccuracy::FAST : TrigAccuracy::EXACT;
+        } else if (arg == "--no-jit") {
+            jit = false;
+        } else {
+            filename = arg;
+        }
+    }
+
+    if (stats) Stats::enable();
 
     std::cout << "Analyzing sessions from: " << filename << std::endl << std::endl;
 
     // Print the expression grammar as requested
-    std::cout << "expression := number | \"(\" expression \")\" | expression operator expression | function \"(\" expression \")\"" << std::endl;
+    std::cout << "expression := number | \"(\" expression \")\" | expression operator expression | function \"(\" [arguments] \")\"" << std::endl;
+    std::cout << "arguments := expression | expression \",\" arguments" << std::endl;
     std::cout << "operator := \"+\" | \"-\" | \"*\" | \"/\" | \"^\"" << std::endl;
-    std::cout << "function := \"sin\" | \"cos\"" << std::endl << std::endl;
-
-        // Parse sessions
-        std::vector<Session> sessions = SessionParser::parseSessions(filename);
-
-        // Print basic summary
-        std::cout << SessionParser::getSummary(sessions);
-
-        // Evaluate sessions: a session is "correct" if all its variables and expressions evaluate without error
-        int correctSessions = 0;
-        std::vector<std::string> sessionReports;
-
-        for (const auto& session : sessions) {
-            // Build lists of formatted outputs for variables and expressions
-            std::vector<std::string> varLines = session.variables;  // Store raw variable defs
-            std::vector<std::string> exprLines;  // Store formatted expression results
-            
-            Evaluator evaluator; // fresh evaluator per session so variables don't leak between sessions
-            bool sessionOK = true;
-            std::string report;
-
-            // First, evaluate variable definitions (they may set state)
-            for (const auto& varLine : session.variables) {
-                try {
-                    evaluator.evaluate(varLine);
-                } catch (const std::exception& e) {
-                    sessionOK = false;
-                    report += "Variable error in session " + std::to_string(session.sessionNumber) + ": '" + varLine + "' -> " + e.what() + "\n";
-                    break;
-                }
-            }
+    std::cout << "function := \"sin\" | \"cos\" | \"sqrt\" | \"exp\" | \"log\" | \"pow\" | \"min\" | \"max\" | \"atan2\" | name" << std::endl;
+    std::cout << "definition := name \"(\" [parameters] \")\" \"=\" expression" << std::endl;
+    std::cout << "parameters := name | name \",\" parameters" << std::endl << std::endl;
 
-            // If variables OK, evaluate expressions
-            if (sessionOK) {
-                for (const auto& expr : session.expressions) {
-                    try {
-                        double val = evaluator.evaluate(expr);
-                        bool hasDecimal = Formatter::hasDecimalPoint(expr);
-                        std::string out = Formatter::formatResult(expr, val, hasDecimal);
-                        exprLines.push_back(out);
-                    } catch (const std::exception& e) {
-                        sessionOK = false;
-                        exprLines.push_back(expr + " => Error: " + std::string(e.what()));
-                        report += "Expression error in session " + std::to_string(session.sessionNumber) + ": '" + expr + "' -> " + e.what() + "\n";
-                        break;
-                    }
-                }
+        // Sessions are read a batch at a time while earlier batches are evaluated, so
+        // nothing grows with the input except the spill files behind PendingOutput.
+        // A binary session file is only mapped: its lines are run from precompiled programs.
+        SessionBinary binary;
+        const SessionBinary* compiled = nullptr;
+        std::optional<SessionSource> source;
+        if (SessionBinary::isBinaryFile(filename)) {
+            if (trig == TrigAccuracy::FAST) {
+                // Its programs were compiled with libm's sin and cos
+                throw std::runtime_error("--trig fast needs text input; " + filename + " is a binary session file");
             }
+            Stats::Timer timer(Stats::READ);
+            binary.load(filename);
+            compiled = &binary;
+            source.emplace(binary);
+        } else {
+            source.emplace(filename);
+        }
 
-            if (sessionOK) {
-                correctSessions++;
-                report = "Session " + std::to_string(session.sessionNumber) + " : OK\n";
-            }
+        // Evaluate sessions: a session is "correct" if all its variables and expressions evaluate without error.
+        // Sessions are independent, so with --jobs each batch runs on a thread pool while the
+        // next batch is read; outcomes are collected in session order, so the output matches
+        // the serial run byte for byte.
+        PendingOutput output;
+        SessionBatch batches[2];
+        size_t current = 0;
 
-            // Store report (report contains OK/errors summary)
-            sessionReports.push_back(report);
-            
-            // Print the session block using structured format
-            std::cout << "----" << std::endl;
-            std::cout << "Session " << session.sessionNumber << std::endl;
-            
-            if (!varLines.empty()) {
-                std::cout << "Variables:" << std::endl;
-                for (const auto& v : varLines) {
-                    std::cout << "  " << v << std::endl;
+        if (jobs > 1) {
+            ThreadPool pool(jobs);
+            const size_t batchSize = SESSIONS_PER_TASK * jobs * 4;
+            bool more = fillBatch(batches[current], *source, batchSize, output);
+            while (more) {
+                SessionBatch& batch = batches[current];
+                for (size_t first = 0; first < batch.sessions.size(); first += SESSIONS_PER_TASK) {
+                    size_t last = std::min(first + SESSIONS_PER_TASK, batch.sessions.size());
+                    pool.submit([&batch, compiled, first, last, trig, jit] {
+                        // One workspace per worker thread, reused by all its tasks
+                        thread_local auto workspace = std::make_unique<SessionWorkspace>();
+                        evaluateRange(batch, first, last, *workspace, compiled, trig, jit);
+                    });
                 }
+                current = 1 - current;
+                more = fillBatch(batches[current], *source, batchSize, output);
+                pool.waitIdle();
+                collectOutcomes(batch, output);
             }
-            
-            if (!exprLines.empty()) {
-                std::cout << "Expression:" << std::endl;
-                for (const auto& e : exprLines) {
-                    std::cout << "  " << e << std::endl;
-                }
+        } else {
+            auto workspace = std::make_unique<SessionWorkspace>();
+            while (fillBatch(batches[current], *source, SESSIONS_PER_TASK, output)) {
+                SessionBatch& batch = batches[current];
+                evaluateRange(batch, 0, batch.sessions.size(), *workspace, compiled, trig, jit);
+                collectOutcomes(batch, output);
             }
-            std::cout << std::endl;
         }
+        Stats::addBytes(Stats::READ, source->bytesRead());
+
+        {
+            Stats::Timer timer(Stats::WRITE);
+
+            // Print basic summary
+            std::cout << SessionParser::getSummaryHeader(output.sessions, output.variables, output.expressions);
+            output.summary.writeTo(std::cout);
+
+            output.blocks.writeTo(std::cout);
 
-        // Print evaluation summary
-        std::cout << "=== SESSION EVALUATION ===" << std::endl;
-        std::cout << "Sessions correct: " << correctSessions << " / " << sessions.size() << std::endl << std::endl;
+            // Print evaluation summary
+            std::cout << "=== SESSION EVALUATION ===" << std::endl;
+            std::cout << "Sessions correct: " << output.correct << " / " << output.sessions << std::endl << std::endl;
 
-        // Print per-session reports (errors or OK)
-        for (const auto& rep : sessionReports) {
-            std::cout << rep << std::endl;
+            // Print per-session reports (errors or OK)
+            output.reports.writeTo(std::cout);
         }
 
+        if (stats) Stats::writeJson(std::cerr);
         return 0;
     } catch (const std::exception& e) {
         std::cerr << "Error: " << e.what() << std::endl;
@@ -0,0 +1,57 @@
+#include <fstream>
+#include <iostream>
+#include <string>
+#include "include/mapped_file.h"
+#include "include/session_binary.h"
+
+void printUsage(const char* programName) {
+    std::cerr << "Usage: " << programName << " (--to-binary | --to-text) <inputFile> <outputFile>" << std::endl;
+    std::cerr << "  --to-binary  compile a calculator or sessions text file into a binary session file" << std::endl;
+    std::cerr << "  --to-text    write back the text a binary session file was compiled from, byte for byte" << std::endl;
+    std::cerr << "  calculator and session_analyzer read either form and print the same results." << std::endl;
+}
+
+void writeFile(const std::string& filename, const std::string& contents) {
+    std::ofstream output(filename, std::ios::binary);
+    if (!output || !output.write(contents.data(), contents.size())) {
+        throw std::runtime_error("could not write file: " + filename);
+    }
+}
+
+int main(int argc, char* argv[]) {
+    try {
+        if (argc != 4) {
+            printUsage(argv[0]);
+            return 1;
+        }
+        std::string mode = argv[1];
+        std::string inputFile = argv[2];
+        std::string outputFile = argv[3];
+
+        if (mode == "--to-binary") {
+            if (SessionBinary::isBinaryFile(inputFile)) {
+                throw std::runtime_error(inputFile + " is already a binary session file");
+            }
+            MappedFile input;
+            if (!input.open(inputFile)) {
+                throw std::runtime_error("could not open input file: " + inputFile);
+            }
+            std::string binary = SessionBinary::fromText(input.contents());
+            writeFile(outputFile, binary);
+            std::cout << "Wrote " << binary.size() << " bytes to " << outputFile << std::endl;
+        } else if (mode == "--to-text") {
+            SessionBinary binary;
+            binary.load(inputFile);
+            std::string text(binary.text());
+            writeFile(outputFile, text);
+            std::cout << "Wrote " << text.size() << " bytes to " << outputFile << std::endl;
+        } else {
+            printUsage(argv[0]);
+            return 1;
+        }
+        return 0;
+    } catch (const std::exception& e) {
+        std::cerr << "Error: " << e.what() << std::endl;
+        return 1;
+    }
+}
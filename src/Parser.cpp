@@ -1,158 +1,467 @@
 #include "Parser.h"
-#include <cctype>
+#include <charconv>
 #include <cmath>
+#include <cerrno>
+#include <cstdlib>
 #include <stdexcept>
+#include <string>
+#include "function_table.h"
+#include "text_scan.h"
 
 Parser::Parser() {}
 
-// Statement := [Variable '='] Expression
-double Parser::parseStatement(const std::string& expr, size_t& pos) {
-    while (pos < expr.size() && isspace(expr[pos])) ++pos;
+CompiledExpr Parser::compile(std::string_view expr) {
+    CompiledExpr out;
+    compile(expr, out);
+    return out;
+}
+
+void Parser::compile(std::string_view expr, CompiledExpr& out) {
+    out.code.clear();
+    out.maxStack = 0;
+    out.features = 0;
+    out.executions = 0;
+    out.jitAttempted = false;
+    out.jit.reset();
+    size_t pos = 0;
+    depth = 0;
+    argumentStarts.clear();
+    parameters.clear();
+    defining = {};
+    parseStatement(expr, pos, out);
+}
+
+int Parser::slotFor(std::string_view name) {
+    int slot = symbols.intern(name);
+    variables.reserveSlots(symbols.size());
+    return slot;
+}
+
+void Parser::resetVariables() {
+    std::vector<std::string> names;                 // new slot -> name
+    std::vector<int> renumbered(symbols.size(), -1);  // old slot -> new slot
+    for (size_t f = 0; f < functionNames.size(); f++) {
+        for (Instruction& ins : functions[f].body) {
+            if (ins.op != OpCode::LOAD_VAR || ins.arg < 0) continue;  // parameters stay as they are
+            if (renumbered[ins.arg] < 0) {
+                renumbered[ins.arg] = static_cast<int>(names.size());
+                names.push_back(symbols.name(ins.arg));
+            }
+            ins.arg = renumbered[ins.arg];
+        }
+    }
+    symbols.clear();
+    variables.clear();
+    for (const std::string& name : names) slotFor(name);
+}
+
+void Parser::emit(CompiledExpr& out, OpCode op, int stackEffect, int arg, double value) {
+    out.code.push_back(Instruction{op, arg, value});
+    depth += stackEffect;
+    if (depth > out.maxStack) out.maxStack = depth;
+}
+
+// Statement := [Variable '='] Expression | Definition
+void Parser::parseStatement(std::string_view expr, size_t& pos, CompiledExpr& out) {
+    pos = TextScan::skip(expr, pos, TextScan::SPACE);
 
     // Check if the expression starts with a variable assignment
-    if (pos < expr.size() && isalpha(expr[pos])) {
+    if (pos < expr.size() && TextScan::is(expr[pos], TextScan::ALPHA)) {
         size_t start = pos;
-        while (pos < expr.size() && (isalnum(expr[pos]) || expr[pos] == '_')) ++pos;
-        std::string varName = expr.substr(start, pos - start);
+        pos = TextScan::skip(expr, pos, TextScan::IDENTIFIER);
+        std::string_view varName = expr.substr(start, pos - start);
 
         // Skip whitespace
-        while (pos < expr.size() && isspace(expr[pos])) ++pos;
+        pos = TextScan::skip(expr, pos, TextScan::SPACE);
 
         if (pos < expr.size() && expr[pos] == '=') {
             ++pos;
-            double value = parseExpression(expr, pos);
-            variables[varName] = value;
-            return value;
+            out.features |= FEATURE_ASSIGNMENT;
+            parseExpression(expr, pos, out);
+            emit(out, OpCode::STORE_VAR, 0, slotFor(varName));
+            return;
+        }
+
+        // "name(" may start a function definition
+        if (pos < expr.size() && expr[pos] == '(') {
+            size_t header = pos + 1;
+            if (parseDefinition(expr, start, header, out)) {
+                pos = header;
+                return;
+            }
         }
 
         // No '=', roll back — treat as expression with variable
         pos = start;
     }
 
-    return parseExpression(expr, pos);
+    parseExpression(expr, pos, out);
 }
 
-// Expression := Term { ('+' | '-') Term }
-double Parser::parseExpression(const std::string& expr, size_t& pos) {
-    double value = parseTerm(expr, pos);
+// Definition := Name '(' [ Name { ',' Name } ] ')' '=' Expression
+//
+// The body is compiled now, into out, then copied into the function table; the
+// definition itself evaluates to 0. Calls in the body are inlined as they are parsed,
+// so the body can only call functions that are already defined, and never the
+// function itself: with no conditionals, a recursive call could never stop expanding.
+bool Parser::parseDefinition(std::string_view expr, size_t start, size_t& pos, CompiledExpr& out) {
+    std::string_view name = expr.substr(start, TextScan::skip(expr, start, TextScan::IDENTIFIER) - start);
+
+    parameters.clear();
+    bool header = false;  // "name(parameters) =" seen
     while (true) {
-        while (pos < expr.size() && isspace(expr[pos])) ++pos;
-        if (pos >= expr.size()) break;
-        char op = expr[pos];
-        if (op != '+' && op != '-') break;
-        ++pos;
-        double rhs = parseTerm(expr, pos);
-        value = (op == '+') ? value + rhs : value - rhs;
+        pos = TextScan::skip(expr, pos, TextScan::SPACE);
+        if (parameters.empty() && pos < expr.size() && expr[pos] == ')') {
+            // No parameters
+            pos = TextScan::skip(expr, pos + 1, TextScan::SPACE);
+            header = pos < expr.size() && expr[pos] == '=';
+            break;
+        }
+        if (pos >= expr.size() || !TextScan::is(expr[pos], TextScan::ALPHA)) break;
+        size_t parameterStart = pos;
+        pos = TextScan::skip(expr, pos, TextScan::IDENTIFIER);
+        parameters.push_back(expr.substr(parameterStart, pos - parameterStart));
+
+        pos = TextScan::skip(expr, pos, TextScan::SPACE);
+        if (pos < expr.size() && expr[pos] == ',') {
+            ++pos;
+            continue;
+        }
+        if (pos < expr.size() && expr[pos] == ')') {
+            pos = TextScan::skip(expr, pos + 1, TextScan::SPACE);
+            header = pos < expr.size() && expr[pos] == '=';
+        }
+        break;
     }
-    return value;
+    if (!header) {
+        parameters.clear();
+        return false;
+    }
+    ++pos;
+    out.features |= FEATURE_ASSIGNMENT | FEATURE_DEFINITION;
+
+    if (FunctionTable::find(name)) throw std::runtime_error("Cannot redefine built-in function: " + std::string(name));
+    for (size_t i = 0; i < parameters.size(); i++) {
+        for (size_t j = 0; j < i; j++) {
+            if (parameters[i] == parameters[j])
+                throw std::runtime_error("Duplicate parameter: " + std::string(parameters[i]));
+        }
+    }
+
+    defining = name;
+    parseExpression(expr, pos, out);
+    defining = {};
+
+    size_t index = static_cast<size_t>(functionNames.intern(name));
+    if (functions.size() <= index) functions.resize(index + 1);
+    DefinedFunction& function = functions[index];
+    function.arity = parameters.size();
+    function.body.assign(out.code.begin(), out.code.end());
+    function.features = out.features & ~(FEATURE_ASSIGNMENT | FEATURE_DEFINITION);
+    function.unusedParameters.clear();
+    for (size_t i = 0; i < parameters.size(); i++) {
+        bool read = false;
+        for (const Instruction& ins : function.body) read = read || (ins.op == OpCode::LOAD_VAR && ins.arg == parameterSlot(i));
+        if (!read) function.unusedParameters.push_back(i);
+    }
+    parameters.clear();
+
+    out.code.clear();
+    out.maxStack = 0;
+    depth = 0;
+    emit(out, OpCode::PUSH_CONST, 1, 0, 0.0);
+    return true;
 }
 
-// Term := Power { ('*' | '/') Power }
-double Parser::parseTerm(const std::string& expr, size_t& pos) {
-    double value = parsePower(expr, pos);
-    while (true) {
-        while (pos < expr.size() && isspace(expr[pos])) ++pos;
-        if (pos >= expr.size()) break;
-        char op = expr[pos];
-        if (op != '*' && op != '/') break;
-        ++pos;
-        double rhs = parsePower(expr, pos);
-        if (op == '*') value *= rhs;
-        else value /= rhs;
+namespace {
+
+// Binding strength of a binary operator: + - < * / < ^
+int precedence(OpCode op) {
+    switch (op) {
+        case OpCode::ADD: case OpCode::SUB: return 1;
+        case OpCode::MUL: case OpCode::DIV: return 2;
+        default: return 3;  // POW
     }
-    return value;
 }
 
-// Power := Factor { '^' Power }  (RIGHT-ASSOCIATIVE)
-double Parser::parsePower(const std::string& expr, size_t& pos) {
-    double value = parseFactor(expr, pos);
-    while (pos < expr.size()) {
-        while (pos < expr.size() && isspace(expr[pos])) ++pos;
-        if (pos >= expr.size() || expr[pos] != '^') break;
-        ++pos;
-        // For right-associativity, recursively call parsePower instead of parseFactor
-        double rhs = parsePower(expr, pos);
-        value = std::pow(value, rhs);
-        break;  // Only one power operation in this recursion level
+bool isBinaryOperator(char c) {
+    return c == '+' || c == '-' || c == '*' || c == '/' || c == '^';
+}
+
+OpCode binaryOpCode(char c) {
+    switch (c) {
+        case '+': return OpCode::ADD;
+        case '-': return OpCode::SUB;
+        case '*': return OpCode::MUL;
+        case '/': return OpCode::DIV;
+        default: return OpCode::POW;
     }
-    return value;
 }
 
-// Factor := Number | '(' Expression ')' | Function | Variable | Unary +/-
-double Parser::parseFactor(const std::string& expr, size_t& pos) {
-    while (pos < expr.size() && isspace(expr[pos])) ++pos;
-    if (pos >= expr.size()) throw std::runtime_error("Unexpected end of expression");
+} // namespace
 
-    if (expr[pos] == '+') { ++pos; return parseFactor(expr, pos); }
-    if (expr[pos] == '-') { ++pos; return -parseFactor(expr, pos); }
+// Expression := Term { ('+' | '-') Term }
+// Term       := Power { ('*' | '/') Power }
+// Power      := Factor [ '^' Power ]             (RIGHT-ASSOCIATIVE)
+// Factor     := ('+' | '-') Factor | Number | Variable
+//             | '(' Expression ')' | Function '(' Expression { ',' Expression } ')'
+//
+// Parsed without recursion (shunting-yard): operators, unary minus and open groups
+// wait on the `pending` stack until their operands have been emitted, so nesting depth
+// and operator chains are limited by memory rather than by the native call stack.
+// The program, features and errors are exactly those of a recursive-descent parser.
+void Parser::parseExpression(std::string_view expr, size_t& pos, CompiledExpr& out) {
+    pending.clear();
 
-    // Function or variable
-    if (isalpha(expr[pos])) {
-        size_t start = pos;
-        while (pos < expr.size() && (isalnum(expr[pos]) || expr[pos] == '_')) ++pos;
-        std::string name = expr.substr(start, pos - start);
+    while (true) {
+        // Operand expected: any number of signs, then a number, variable or group
+        pos = TextScan::skip(expr, pos, TextScan::SPACE);
+        if (pos >= expr.size()) throw std::runtime_error("Unexpected end of expression");
 
-        // If function call
-        while (pos < expr.size() && isspace(expr[pos])) ++pos;
-        if (pos < expr.size() && expr[pos] == '(') {
+        char c = expr[pos];
+        if (c == '+') { ++pos; continue; }
+        if (c == '-') { ++pos; pending.push_back(Pending{Pending::NEGATE}); continue; }
+
+        if (TextScan::is(c, TextScan::ALPHA)) {
+            // Function or variable
+            size_t start = pos;
+            pos = TextScan::skip(expr, pos, TextScan::IDENTIFIER);
+            size_t length = pos - start;
+
+            // If function call, the name is checked once its arguments have been parsed
+            pos = TextScan::skip(expr, pos, TextScan::SPACE);
+            if (pos < expr.size() && expr[pos] == '(') {
+                ++pos;
+                out.features |= FEATURE_FUNCTION_CALL;
+                size_t close = TextScan::skip(expr, pos, TextScan::SPACE);
+                if (close >= expr.size() || expr[close] != ')') {
+                    pending.push_back(Pending{Pending::CALL, OpCode::ADD, start, length, 1, argumentStarts.size()});
+                    argumentStarts.push_back(out.code.size());
+                    continue;
+                }
+                // "name()": without arguments the call is complete at once
+                pos = close + 1;
+                emitCall(expr.substr(start, length), 0, argumentStarts.size(), out);
+            } else {
+                // Inside a definition, a parameter is read through its placeholder slot
+                std::string_view name = expr.substr(start, length);
+                size_t parameter = 0;
+                while (parameter < parameters.size() && parameters[parameter] != name) parameter++;
+                if (parameter < parameters.size()) {
+                    emit(out, OpCode::LOAD_VAR, 1, parameterSlot(parameter));
+                } else {
+                    // Otherwise, variable lookup: the name is resolved to a slot now,
+                    // and the value is read from that slot when the program runs
+                    out.features |= FEATURE_VARIABLES;
+                    emit(out, OpCode::LOAD_VAR, 1, slotFor(name));
+                }
+            }
+        } else if (c == '(') {
+            // Parentheses
             ++pos;
-            double arg = parseExpression(expr, pos);
-            if (pos >= expr.size() || expr[pos] != ')')
-                throw std::runtime_error("Missing ')' in function call");
+            out.features |= FEATURE_PARENTHESES;
+            pending.push_back(Pending{Pending::GROUP});
+            continue;
+        } else {
+            // Number
+            emit(out, OpCode::PUSH_CONST, 1, 0, parseNumber(expr, pos, out.features));
+        }
+
+        // An operand is complete: apply its signs, close any groups that end here,
+        // and stop at the next binary operator (or at the end of the expression)
+        while (true) {
+            while (!pending.empty() && pending.back().kind == Pending::NEGATE) {
+                pending.pop_back();
+                emit(out, OpCode::NEG, 0);
+            }
+
+            pos = TextScan::skip(expr, pos, TextScan::SPACE);
+            if (pos < expr.size() && isBinaryOperator(expr[pos])) {
+                OpCode op = binaryOpCode(expr[pos]);
+                ++pos;
+                if (op == OpCode::POW) out.features |= FEATURE_POWER;
+                // Emit waiting operators that bind at least as tightly (^ is right-associative)
+                int prec = precedence(op);
+                while (!pending.empty() && pending.back().kind == Pending::BINARY) {
+                    int top = precedence(pending.back().op);
+                    if (top < prec || (top == prec && op == OpCode::POW)) break;
+                    emit(out, pending.back().op, -1);
+                    pending.pop_back();
+                }
+                pending.push_back(Pending{Pending::BINARY, op});
+                break;
+            }
+
+            // The expression inside the innermost group ends here
+            while (!pending.empty() && pending.back().kind == Pending::BINARY) {
+                emit(out, pending.back().op, -1);
+                pending.pop_back();
+            }
+            if (pending.empty()) return;  // anything after a complete expression is ignored
+
+            // A comma inside a call starts its next argument
+            if (pos < expr.size() && expr[pos] == ',' && pending.back().kind == Pending::CALL) {
+                ++pos;
+                pending.back().arguments++;
+                argumentStarts.push_back(out.code.size());
+                break;
+            }
+
+            Pending group = pending.back();
+            pending.pop_back();
+            if (pos >= expr.size() || expr[pos] != ')') {
+                throw std::runtime_error(group.kind == Pending::CALL ? "Missing ')' in function call" : "Missing ')'");
+            }
             ++pos;
 
-            if (name == "sin") return std::sin(arg);
-            if (name == "cos") return std::cos(arg);
-            throw std::runtime_error("Unknown function: " + name);
+            if (group.kind == Pending::CALL) {
+                emitCall(expr.substr(group.nameStart, group.nameLength), group.arguments, group.firstArgument, out);
+            }
+            // The closed group is itself an operand
         }
+    }
+}
 
-        // Otherwise, variable lookup
-        if (variables.find(name) == variables.end())
-            throw std::runtime_error("Undefined variable: " + name);
-        return variables[name];
+// Resolve a called name: built-in functions through the FunctionTable, then functions
+// defined in this session. A built-in's opcode replaces the arguments on the operand
+// stack with the result; a defined function's body is inlined in place of the
+// arguments' code, with each parameter read replaced by the code of its argument.
+void Parser::emitCall(std::string_view name, int arguments, size_t firstArgument, CompiledExpr& out) {
+    const FunctionTable::Function* builtin = FunctionTable::find(name);
+    int defined = builtin ? -1 : functionNames.find(name);
+    if (!builtin && name == defining) throw std::runtime_error("Recursive function call: " + std::string(name));
+    if (!builtin && defined < 0) throw std::runtime_error("Unknown function: " + std::string(name));
+
+    int arity = builtin ? builtin->arity : static_cast<int>(functions[defined].arity);
+    if (arguments != arity) {
+        throw std::runtime_error("Wrong number of function arguments: " + std::string(name) + " takes " +
+                                 std::to_string(arity));
     }
 
-    // Parentheses
-    if (expr[pos] == '(') {
-        ++pos;
-        double value = parseExpression(expr, pos);
-        if (pos >= expr.size() || expr[pos] != ')')
-            throw std::runtime_error("Missing ')'");
-        ++pos;
-        return value;
+    if (builtin) {
+        OpCode op = builtin->op;
+        if (trigAccuracy == TrigAccuracy::FAST) {
+            if (op == OpCode::SIN) op = OpCode::SIN_FAST;
+            else if (op == OpCode::COS) op = OpCode::COS_FAST;
+        }
+        emit(out, op, 1 - arguments);
+        argumentStarts.resize(firstArgument);
+        return;
+    }
+
+    const DefinedFunction& function = functions[defined];
+    size_t codeStart = arguments ? argumentStarts[firstArgument] : out.code.size();
+    argumentCode.assign(out.code.begin() + codeStart, out.code.end());
+    out.code.resize(codeStart);
+    depth -= arguments;
+
+    // Code of argument i: argumentCode[argumentBegin(i), argumentBegin(i + 1))
+    auto argumentBegin = [&](size_t i) {
+        return i < function.arity ? argumentStarts[firstArgument + i] - codeStart : argumentCode.size();
+    };
+
+    // An argument the body never reads still reads its variables, so an undefined one
+    // is reported as it would be for any other expression; the values are discarded
+    for (size_t parameter : function.unusedParameters) {
+        for (size_t i = argumentBegin(parameter); i < argumentBegin(parameter + 1); i++) {
+            if (argumentCode[i].op != OpCode::LOAD_VAR) continue;
+            emit(out, OpCode::LOAD_VAR, 1, argumentCode[i].arg);
+            emit(out, OpCode::DROP, -1);
+        }
+    }
+
+    for (const Instruction& ins : function.body) {
+        if (ins.op != OpCode::LOAD_VAR || ins.arg >= 0) {
+            emit(out, ins.op, stackEffect(ins.op), ins.arg, ins.value);
+        } else {
+            size_t parameter = static_cast<size_t>(-1 - ins.arg);
+            for (size_t i = argumentBegin(parameter); i < argumentBegin(parameter + 1); i++) {
+                const Instruction& arg = argumentCode[i];
+                emit(out, arg.op, stackEffect(arg.op), arg.arg, arg.value);
+            }
+        }
+        if (out.code.size() > MAX_INLINED_CODE) {
+            throw std::runtime_error("Function calls expand too far: more than " +
+                                     std::to_string(MAX_INLINED_CODE) + " instructions");
+        }
     }
+    out.features |= function.features;
+    argumentStarts.resize(firstArgument);
+}
 
-    // Number
-    return parseNumber(expr, pos);
+namespace {
+
+// Convert digits in the given base straight from the input buffer
+double convertInteger(std::string_view digits, int base) {
+    unsigned long long value = 0;
+    auto result = std::from_chars(digits.data(), digits.data() + digits.size(), value, base);
+    if (result.ec == std::errc::result_out_of_range)
+        throw std::runtime_error("Number out of range");
+    if (result.ec != std::errc())
+        throw std::runtime_error("Invalid number");
+    return static_cast<double>(value);
 }
 
+// Convert the longest decimal prefix of the given text (digits and '.')
+double convertDecimal(std::string_view text) {
+    double value = 0.0;
+#if defined(__cpp_lib_to_chars)
+    auto result = std::from_chars(text.data(), text.data() + text.size(), value);
+    if (result.ec == std::errc::result_out_of_range)
+        throw std::runtime_error("Number out of range");
+    if (result.ec != std::errc())
+        throw std::runtime_error("Invalid number");
+#else
+    // Standard libraries without floating-point from_chars: strtod on a stack copy
+    char buffer[128];
+    std::string longText;
+    const char* start = buffer;
+    if (text.size() < sizeof(buffer)) {
+        text.copy(buffer, text.size());
+        buffer[text.size()] = '\0';
+    } else {
+        longText.assign(text);
+        start = longText.c_str();
+    }
+    char* end = nullptr;
+    errno = 0;
+    value = std::strtod(start, &end);
+    if (end == start)
+        throw std::runtime_error("Invalid number");
+    if (errno == ERANGE && std::abs(value) == HUGE_VAL)
+        throw std::runtime_error("Number out of range");
+#endif
+    return value;
+}
+
+} // namespace
+
 // Parse numbers in binary (b), hex (0x), or decimal
-double Parser::parseNumber(const std::string& expr, size_t& pos) {
-    while (pos < expr.size() && isspace(expr[pos])) ++pos;
+double Parser::parseNumber(std::string_view expr, size_t& pos, unsigned& features) {
+    pos = TextScan::skip(expr, pos, TextScan::SPACE);
 
     size_t start = pos;
     // Hex
     if (pos < expr.size() && expr[pos] == '0' && (pos + 1 < expr.size()) &&
         (expr[pos + 1] == 'x' || expr[pos + 1] == 'X')) {
         pos += 2;
+        features |= FEATURE_HEX_LITERAL;
         size_t hexStart = pos;
-        while (pos < expr.size() && std::isxdigit(expr[pos])) ++pos;
-        std::string hexStr = expr.substr(hexStart, pos - hexStart);
-        return static_cast<double>(std::stoul(hexStr, nullptr, 16));
+        pos = TextScan::skip(expr, pos, TextScan::HEX_DIGIT);
+        return convertInteger(expr.substr(hexStart, pos - hexStart), 16);
     }
 
     // Binary (ends with 'b')
-    while (pos < expr.size() && (expr[pos] == '0' || expr[pos] == '1')) ++pos;
+    pos = TextScan::skip(expr, pos, TextScan::BINARY_DIGIT);
     if (pos < expr.size() && (expr[pos] == 'b' || expr[pos] == 'B')) {
-        std::string binStr = expr.substr(start, pos - start);
+        std::string_view binDigits = expr.substr(start, pos - start);
         ++pos;
-        unsigned long val = std::stoul(binStr, nullptr, 2);
-        return static_cast<double>(val);
+        features |= FEATURE_BINARY_LITERAL;
+        return convertInteger(binDigits, 2);
     }
 
-    // Decimal
+    // Decimal: consume every digit and '.', converting the longest valid prefix
     pos = start;
-    while (pos < expr.size() && (std::isdigit(expr[pos]) || expr[pos] == '.')) ++pos;
-    std::string numStr = expr.substr(start, pos - start);
-    return std::stod(numStr);
+    pos = TextScan::skip(expr, pos, TextScan::DECIMAL);
+    return convertDecimal(expr.substr(start, pos - start));
 }
@@ -0,0 +1,78 @@
+#include "evaluator.h"
+#include "simd_kernels.h"
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+
+namespace {
+    // Rows processed per pass over the program; sized so a few stack slots stay in L1
+    const size_t BLOCK_ROWS = 256;
+}
+
+void Evaluator::evaluateBatch(const CompiledExpr& program, const ColumnMap& columns,
+                              size_t rows, double* out) {
+    // Resolve every variable once: either a column or a value broadcast to all rows
+    const SymbolTable& symbols = parser.getSymbols();
+    Environment& variables = parser.getEnvironment();
+    std::vector<const double*> columnOf(symbols.size(), nullptr);
+
+    for (const Instruction& ins : program.code) {
+        if (ins.op != OpCode::LOAD_VAR || columnOf[ins.arg]) continue;
+        auto col = columns.find(symbols.name(ins.arg));
+        if (col != columns.end()) {
+            columnOf[ins.arg] = col->second;
+        } else if (!variables.defined[ins.arg]) {
+            throw std::runtime_error("Undefined variable: " + symbols.name(ins.arg));
+        }
+    }
+
+    for (const Instruction& ins : program.code) {
+        if (ins.op == OpCode::STORE_VAR)
+            throw std::runtime_error("Assignments cannot be evaluated in batch mode");
+    }
+
+    if (batchStack.size() < program.maxStack * BLOCK_ROWS)
+        batchStack.resize(program.maxStack * BLOCK_ROWS);
+
+    for (size_t first = 0; first < rows; first += BLOCK_ROWS) {
+        size_t n = std::min(BLOCK_ROWS, rows - first);
+        double* top = batchStack.data();  // block one past the top of the stack
+
+        for (const Instruction& ins : program.code) {
+            switch (ins.op) {
+                case OpCode::PUSH_CONST:
+                    SimdKernels::fill(top, ins.value, n);
+                    top += BLOCK_ROWS;
+                    break;
+                case OpCode::LOAD_VAR:
+                    if (columnOf[ins.arg])
+                        std::memcpy(top, columnOf[ins.arg] + first, n * sizeof(double));
+                    else
+                        SimdKernels::fill(top, variables.values[ins.arg], n);
+                    top += BLOCK_ROWS;
+                    break;
+                case OpCode::STORE_VAR:
+                    break;
+                case OpCode::ADD: top -= BLOCK_ROWS; SimdKernels::add(top - BLOCK_ROWS, top, n); break;
+                case OpCode::SUB: top -= BLOCK_ROWS; SimdKernels::sub(top - BLOCK_ROWS, top, n); break;
+                case OpCode::MUL: top -= BLOCK_ROWS; SimdKernels::mul(top - BLOCK_ROWS, top, n); break;
+                case OpCode::DIV: top -= BLOCK_ROWS; SimdKernels::div(top - BLOCK_ROWS, top, n); break;
+                case OpCode::POW: top -= BLOCK_ROWS; SimdKernels::pow(top - BLOCK_ROWS, top, n); break;
+                case OpCode::NEG: SimdKernels::neg(top - BLOCK_ROWS, n); break;
+                case OpCode::SIN: SimdKernels::sin(top - BLOCK_ROWS, n); break;
+                case OpCode::COS: SimdKernels::cos(top - BLOCK_ROWS, n); break;
+                case OpCode::SQRT: SimdKernels::sqrt(top - BLOCK_ROWS, n); break;
+                case OpCode::EXP: SimdKernels::exp(top - BLOCK_ROWS, n); break;
+                case OpCode::LOG: SimdKernels::log(top - BLOCK_ROWS, n); break;
+                case OpCode::MIN: top -= BLOCK_ROWS; SimdKernels::min(top - BLOCK_ROWS, top, n); break;
+                case OpCode::MAX: top -= BLOCK_ROWS; SimdKernels::max(top - BLOCK_ROWS, top, n); break;
+                case OpCode::ATAN2: top -= BLOCK_ROWS; SimdKernels::atan2(top - BLOCK_ROWS, top, n); break;
+                case OpCode::SIN_FAST: SimdKernels::sinFast(top - BLOCK_ROWS, n); break;
+                case OpCode::COS_FAST: SimdKernels::cosFast(top - BLOCK_ROWS, n); break;
+                case OpCode::DROP: top -= BLOCK_ROWS; break;
+            }
+        }
+
+        std::memcpy(out + first, top - BLOCK_ROWS, n * sizeof(double));
+    }
+}
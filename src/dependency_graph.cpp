@@ -0,0 +1,184 @@
+#include "dependency_graph.h"
+#include <algorithm>
+#include <stdexcept>
+
+size_t DependencyGraph::define(std::string_view statement) {
+    Node node;
+    node.text = std::string(statement);
+    node.program = evaluator.compile(statement);
+
+    for (const Instruction& ins : node.program.code) {
+        if (ins.op == OpCode::LOAD_VAR &&
+            std::find(node.reads.begin(), node.reads.end(), ins.arg) == node.reads.end()) {
+            node.reads.push_back(ins.arg);
+        } else if (ins.op == OpCode::STORE_VAR) {
+            node.writes = ins.arg;
+        }
+    }
+
+    ensureSlots(evaluator.getSymbols().size());
+    checkForCycle(node);
+
+    // A new definition of a derived variable replaces the old formula in place
+    size_t id;
+    if (node.writes >= 0 && writerOf[node.writes] >= 0) {
+        id = static_cast<size_t>(writerOf[node.writes]);
+        unlink(id);
+        nodes[id] = std::move(node);
+    } else if (!freeIds.empty()) {
+        id = freeIds.back();
+        freeIds.pop_back();
+        nodes[id] = std::move(node);
+    } else {
+        id = nodes.size();
+        nodes.push_back(std::move(node));
+    }
+    link(id);
+
+    evaluateNode(id);
+    if (nodes[id].writes >= 0) recomputeFrom(nodes[id].writes);
+    return id;
+}
+
+size_t DependencyGraph::assign(std::string_view name, double value) {
+    evaluator.setVariable(name, value);
+    int slot = evaluator.getSymbols().find(name);
+    ensureSlots(evaluator.getSymbols().size());
+
+    // Assigning an input directly overrides any formula that used to define it
+    if (writerOf[slot] >= 0) {
+        size_t old = static_cast<size_t>(writerOf[slot]);
+        unlink(old);
+        nodes[old] = Node();
+        freeIds.push_back(old);
+    }
+    return recomputeFrom(slot);
+}
+
+double DependencyGraph::value(size_t id) const {
+    const Node& node = nodes.at(id);
+    if (!node.error.empty()) throw std::runtime_error(node.error);
+    return node.value;
+}
+
+void DependencyGraph::ensureSlots(size_t count) {
+    if (readersOf.size() < count) {
+        readersOf.resize(count);
+        writerOf.resize(count, -1);
+    }
+}
+
+void DependencyGraph::link(size_t id) {
+    const Node& node = nodes[id];
+    for (int slot : node.reads) readersOf[slot].push_back(id);
+    if (node.writes >= 0) writerOf[node.writes] = static_cast<long>(id);
+}
+
+void DependencyGraph::unlink(size_t id) {
+    const Node& node = nodes[id];
+    for (int slot : node.reads) {
+        auto& readers = readersOf[slot];
+        readers.erase(std::remove(readers.begin(), readers.end(), id), readers.end());
+    }
+    if (node.writes >= 0 && writerOf[node.writes] == static_cast<long>(id)) {
+        writerOf[node.writes] = -1;
+    }
+}
+
+// Follow the variables a new formula reads back through the formulas defining them;
+// reaching the variable the formula defines means a cycle
+void DependencyGraph::checkForCycle(const Node& node) const {
+    if (node.writes < 0) return;
+    const SymbolTable& symbols = evaluator.getSymbols();
+
+    // Depth-first search with an explicit stack; parent links rebuild the cycle path
+    std::vector<int> parent(writerOf.size(), -2);
+    std::vector<int> stack;
+    for (int slot : node.reads) {
+        if (parent[slot] == -2) {
+            parent[slot] = -1;
+            stack.push_back(slot);
+        }
+    }
+
+    while (!stack.empty()) {
+        int slot = stack.back();
+        stack.pop_back();
+
+        if (slot == node.writes) {
+            std::vector<int> chain;
+            for (int s = slot; s >= 0; s = parent[s]) chain.push_back(s);
+            std::string path = symbols.name(node.writes);
+            for (auto it = chain.rbegin(); it != chain.rend(); ++it) {
+                path += " -> " + symbols.name(*it);
+            }
+            throw std::runtime_error("Dependency cycle: " + path);
+        }
+
+        long writer = writerOf[slot];
+        if (writer < 0) continue;
+        for (int next : nodes[writer].reads) {
+            if (parent[next] == -2) {
+                parent[next] = slot;
+                stack.push_back(next);
+            }
+        }
+    }
+}
+
+// Recompute every formula downstream of a changed variable, each exactly
+// once and only after all changed formulas it depends on (Kahn's algorithm)
+size_t DependencyGraph::recomputeFrom(int slot) {
+    if (pendingInputs.size() < nodes.size()) pendingInputs.resize(nodes.size(), 0);
+
+    // Collect the affected formulas and count how many affected formulas feed each one
+    affected.clear();
+    std::vector<int> frontier{slot};
+    while (!frontier.empty()) {
+        int changed = frontier.back();
+        frontier.pop_back();
+        for (size_t reader : readersOf[changed]) {
+            if (pendingInputs[reader]++ == 0) {
+                affected.push_back(reader);
+                if (nodes[reader].writes >= 0) frontier.push_back(nodes[reader].writes);
+            }
+        }
+    }
+
+    // pendingInputs now counts edges from the changed slot and from affected formulas.
+    // Formulas reached only through the changed slot itself are ready first.
+    ready.clear();
+    for (size_t id : affected) {
+        unsigned fromChanged = static_cast<unsigned>(
+            std::count(nodes[id].reads.begin(), nodes[id].reads.end(), slot));
+        pendingInputs[id] -= fromChanged;
+        if (pendingInputs[id] == 0) ready.push_back(id);
+    }
+
+    size_t recomputed = 0;
+    while (!ready.empty()) {
+        size_t id = ready.back();
+        ready.pop_back();
+        evaluateNode(id);
+        recomputed++;
+
+        int written = nodes[id].writes;
+        if (written < 0) continue;
+        for (size_t reader : readersOf[written]) {
+            if (pendingInputs[reader] > 0 && --pendingInputs[reader] == 0) ready.push_back(reader);
+        }
+    }
+
+    for (size_t id : affected) pendingInputs[id] = 0;
+    return recomputed;
+}
+
+void DependencyGraph::evaluateNode(size_t id) {
+    Node& node = nodes[id];
+    try {
+        node.value = evaluator.execute(node.program);
+        node.error.clear();
+    } catch (const std::exception& e) {
+        node.error = e.what();
+    }
+}
@@ -1,6 +1,144 @@
 #include "evaluator.h"
+#include "fast_trig.h"
+#include "stats.h"
+#include <ostream>
+#include <cmath>
+#include <stdexcept>
 
-double Evaluator::evaluate(const std::string& expression) {
-    size_t pos = 0;
-    return parser.parseStatement(expression, pos);
+// Compiles into a reused program, so repeated calls do not allocate once warmed up
+double Evaluator::evaluate(std::string_view expression) {
+    if (Stats::enabled()) return evaluateWithStats(expression);
+    if (!cache.enabled()) return compileAndRun(expression);
+
+    double value;
+    if (cache.lookup(expression, parser.getEnvironment(), value, scratch.features)) return value;
+    value = compileAndRun(expression);
+    cache.store(scratch, parser.getEnvironment(), value);
+    return value;
+}
+
+double Evaluator::compileAndRun(std::string_view expression) {
+    compileProgram(expression, scratch);
+    return interpret(scratch, parser.getEnvironment());
+}
+
+// Same as evaluate(), timing the cache lookup, parse and evaluate stages for --stats, so
+// evaluate counts one call per program actually run. Kept out of evaluate() so errors
+// thrown there do not unwind through the timers when stats are off.
+double Evaluator::evaluateWithStats(std::string_view expression) {
+    double value;
+    if (cache.enabled()) {
+        Stats::Timer timer(Stats::CACHE);
+        bool hit = cache.lookup(expression, parser.getEnvironment(), value, scratch.features);
+        Stats::recordCacheLookup(hit);
+        if (hit) return value;
+    }
+    {
+        Stats::Timer timer(Stats::PARSE);
+        compileProgram(expression, scratch);
+    }
+    Stats::Timer timer(Stats::EVALUATE);
+    value = interpret(scratch, parser.getEnvironment());
+    if (cache.enabled()) cache.store(scratch, parser.getEnvironment(), value);
+    return value;
+}
+
+CompiledExpr Evaluator::compile(std::string_view expression) {
+    CompiledExpr program;
+    compileProgram(expression, program);
+    return program;
+}
+
+void Evaluator::compile(std::string_view expression, CompiledExpr& out) {
+    compileProgram(expression, out);
+}
+
+void Evaluator::compileProgram(std::string_view expression, CompiledExpr& program) {
+    parser.compile(expression, program);
+    // Cached results of calls may have inlined an earlier definition of the same name
+    if (program.features & FEATURE_DEFINITION) cache.clear();
+    optimize(expression, program);
+}
+
+void Evaluator::optimize(std::string_view expression, CompiledExpr& program) {
+    if (!optimizationDump) {
+        optimizer.optimize(program);
+        return;
+    }
+
+    std::string before = Optimizer::formatTree(program, parser.getSymbols());
+    optimizer.optimize(program);
+    *optimizationDump << "optimize: " << expression << "\n"
+                      << "  before: " << before << "\n"
+                      << "  after:  " << Optimizer::formatTree(program, parser.getSymbols()) << "\n";
+}
+
+double Evaluator::execute(const CompiledExpr& program) {
+    return execute(program, parser.getEnvironment());
+}
+
+double Evaluator::execute(const CompiledExpr& program, Environment& env) {
+    if (jitEnabled) {
+        if (!program.jit && !program.jitAttempted && ++program.executions > jitThreshold) {
+            program.jitAttempted = true;
+            program.jit = jit.compile(program);
+        }
+
+        if (program.jit) {
+            const JitCode& native = *program.jit;
+            env.reserveSlots(parser.getSymbols().size());
+            bool ready = true;
+            for (int slot : native.reads) {
+                if (!env.defined[slot]) { ready = false; break; }
+            }
+            // An undefined variable falls back to the interpreter, which reports it
+            if (ready) {
+                double result = native.function()(env.values.data());
+                if (native.storeSlot >= 0) env.stored(native.storeSlot);
+                return result;
+            }
+        }
+    }
+    return interpret(program, env);
+}
+
+double Evaluator::interpret(const CompiledExpr& program, Environment& env) {
+    if (stack.size() < program.maxStack) stack.resize(program.maxStack);
+    env.reserveSlots(parser.getSymbols().size());
+    double* sp = stack.data();  // points one past the top of the stack
+
+    for (const Instruction& ins : program.code) {
+        switch (ins.op) {
+            case OpCode::PUSH_CONST:
+                *sp++ = ins.value;
+                break;
+            case OpCode::LOAD_VAR:
+                if (!env.defined[ins.arg])
+                    throw std::runtime_error("Undefined variable: " + parser.getSymbols().name(ins.arg));
+                *sp++ = env.values[ins.arg];
+                break;
+            case OpCode::STORE_VAR:
+                env.set(ins.arg, sp[-1]);
+                break;
+            case OpCode::ADD: --sp; sp[-1] = sp[-1] + sp[0]; break;
+            case OpCode::SUB: --sp; sp[-1] = sp[-1] - sp[0]; break;
+            case OpCode::MUL: --sp; sp[-1] = sp[-1] * sp[0]; break;
+            case OpCode::DIV: --sp; sp[-1] = sp[-1] / sp[0]; break;
+            case OpCode::POW: --sp; sp[-1] = std::pow(sp[-1], sp[0]); break;
+            case OpCode::NEG: sp[-1] = -sp[-1]; break;
+            case OpCode::SIN: sp[-1] = std::sin(sp[-1]); break;
+            case OpCode::COS: sp[-1] = std::cos(sp[-1]); break;
+            case OpCode::SQRT: sp[-1] = std::sqrt(sp[-1]); break;
+            case OpCode::EXP: sp[-1] = std::exp(sp[-1]); break;
+            case OpCode::LOG: sp[-1] = std::log(sp[-1]); break;
+            case OpCode::MIN: --sp; sp[-1] = FunctionTable::min(sp[-1], sp[0]); break;
+            case OpCode::MAX: --sp; sp[-1] = FunctionTable::max(sp[-1], sp[0]); break;
+            case OpCode::ATAN2: --sp; sp[-1] = std::atan2(sp[-1], sp[0]); break;
+            case OpCode::SIN_FAST: sp[-1] = FastTrig::sin(sp[-1]); break;
+            case OpCode::COS_FAST: sp[-1] = FastTrig::cos(sp[-1]); break;
+            case OpCode::DROP: --sp; break;
+        }
+    }
+
+    return sp[-1];
 }
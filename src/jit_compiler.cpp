@@ -0,0 +1,257 @@
+#include "jit_compiler.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include "fast_trig.h"
+#include "function_table.h"
+
+#if defined(__x86_64__) && defined(__linux__)
+#define JIT_X86_64 1
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+#ifdef JIT_X86_64
+
+namespace {
+
+double callSin(double x) { return std::sin(x); }
+double callCos(double x) { return std::cos(x); }
+double callPow(double x, double y) { return std::pow(x, y); }
+double callExp(double x) { return std::exp(x); }
+double callLog(double x) { return std::log(x); }
+double callMin(double x, double y) { return FunctionTable::min(x, y); }
+double callMax(double x, double y) { return FunctionTable::max(x, y); }
+double callAtan2(double y, double x) { return std::atan2(y, x); }
+double callSinFast(double x) { return FastTrig::sin(x); }
+double callCosFast(double x) { return FastTrig::cos(x); }
+
+// Helper called by a one-argument opcode, or nullptr
+const void* unaryHelper(OpCode op) {
+    switch (op) {
+        case OpCode::SIN: return reinterpret_cast<const void*>(&callSin);
+        case OpCode::COS: return reinterpret_cast<const void*>(&callCos);
+        case OpCode::EXP: return reinterpret_cast<const void*>(&callExp);
+        case OpCode::LOG: return reinterpret_cast<const void*>(&callLog);
+        case OpCode::SIN_FAST: return reinterpret_cast<const void*>(&callSinFast);
+        case OpCode::COS_FAST: return reinterpret_cast<const void*>(&callCosFast);
+        default: return nullptr;
+    }
+}
+
+// Helper called by a two-argument opcode (lhs in xmm0, rhs in xmm1), or nullptr
+const void* binaryHelper(OpCode op) {
+    switch (op) {
+        case OpCode::POW: return reinterpret_cast<const void*>(&callPow);
+        case OpCode::MIN: return reinterpret_cast<const void*>(&callMin);
+        case OpCode::MAX: return reinterpret_cast<const void*>(&callMax);
+        case OpCode::ATAN2: return reinterpret_cast<const void*>(&callAtan2);
+        default: return nullptr;
+    }
+}
+
+// Minimal x86-64 encoder for the handful of instructions the JIT needs.
+// Register use: rbx = value array, xmm0 = top of the operand stack,
+// [rsp + 8*i] = operand stack entries below the top, xmm1/rax = scratch.
+class Emitter {
+public:
+    std::vector<uint8_t> bytes;
+
+    void raw(std::initializer_list<uint8_t> b) { bytes.insert(bytes.end(), b); }
+
+    void imm32(int32_t v) {
+        uint8_t b[4];
+        std::memcpy(b, &v, 4);
+        bytes.insert(bytes.end(), b, b + 4);
+    }
+
+    void imm64(uint64_t v) {
+        uint8_t b[8];
+        std::memcpy(b, &v, 8);
+        bytes.insert(bytes.end(), b, b + 8);
+    }
+
+    // SSE2 scalar op (0x10 load, 0x11 store, 0x58 add, 0x59 mul, 0x5C sub, 0x5E div)
+    // between xmm0 and [rsp + disp]
+    void sdStack(uint8_t opcode, int32_t disp) { raw({0xF2, 0x0F, opcode, 0x84, 0x24}); imm32(disp); }
+
+    // Same with [rbx + disp]
+    void sdValues(uint8_t opcode, int32_t disp) { raw({0xF2, 0x0F, opcode, 0x83}); imm32(disp); }
+
+    void movRaxImm(uint64_t v) { raw({0x48, 0xB8}); imm64(v); }
+    void movqXmm0Rax() { raw({0x66, 0x48, 0x0F, 0x6E, 0xC0}); }
+    void movqXmm1Rax() { raw({0x66, 0x48, 0x0F, 0x6E, 0xC8}); }
+    void movapdXmm1Xmm0() { raw({0x66, 0x0F, 0x28, 0xC8}); }
+    void callRax() { raw({0xFF, 0xD0}); }
+
+    void callFunction(const void* fn) {
+        movRaxImm(reinterpret_cast<uint64_t>(fn));
+        callRax();
+    }
+};
+
+// Second opcode byte of addsd / subsd / mulsd / divsd
+uint8_t arithmeticOpcode(OpCode op) {
+    switch (op) {
+        case OpCode::ADD: return 0x58;
+        case OpCode::SUB: return 0x5C;
+        case OpCode::MUL: return 0x59;
+        default: return 0x5E;
+    }
+}
+
+int32_t stackDisp(size_t index) { return static_cast<int32_t>(index * 8); }
+int32_t slotDisp(int slot) { return static_cast<int32_t>(slot) * 8; }
+
+bool generate(const CompiledExpr& program, Emitter& e) {
+    // Stack frame: one 8-byte cell per operand stack entry, kept 16-byte aligned for calls
+    size_t frame = (program.maxStack * 8 + 15) & ~static_cast<size_t>(15);
+    if (frame > 0x7FFFFFF0) return false;
+
+    e.raw({0x53});              // push rbx
+    e.raw({0x48, 0x89, 0xFB});  // mov rbx, rdi
+    e.raw({0x48, 0x81, 0xEC}); e.imm32(static_cast<int32_t>(frame));  // sub rsp, frame
+
+    size_t depth = 0;  // values on the operand stack; the top lives in xmm0
+    auto spillTop = [&] {
+        if (depth > 0) e.sdStack(0x11, stackDisp(depth - 1));  // movsd [rsp+..], xmm0
+    };
+
+    for (const Instruction& ins : program.code) {
+        switch (ins.op) {
+            case OpCode::PUSH_CONST: {
+                spillTop();
+                uint64_t bits;
+                std::memcpy(&bits, &ins.value, 8);
+                e.movRaxImm(bits);
+                e.movqXmm0Rax();
+                depth++;
+                break;
+            }
+            case OpCode::LOAD_VAR:
+                spillTop();
+                e.sdValues(0x10, slotDisp(ins.arg));  // movsd xmm0, [rbx+slot*8]
+                depth++;
+                break;
+            case OpCode::STORE_VAR:
+                e.sdValues(0x11, slotDisp(ins.arg));  // movsd [rbx+slot*8], xmm0
+                break;
+            case OpCode::ADD:
+            case OpCode::SUB:
+            case OpCode::MUL:
+            case OpCode::DIV:
+                // lhs op rhs with the lhs as destination, as the interpreter computes it:
+                // with two NaN operands x86 returns the destination's, so even the
+                // commutative ops must not swap them
+                e.movapdXmm1Xmm0();
+                e.sdStack(0x10, stackDisp(depth - 2));
+                e.raw({0xF2, 0x0F, arithmeticOpcode(ins.op), 0xC1});  // op xmm0, xmm1
+                depth--;
+                break;
+            case OpCode::POW:
+            case OpCode::MIN:
+            case OpCode::MAX:
+            case OpCode::ATAN2:
+                e.movapdXmm1Xmm0();
+                e.sdStack(0x10, stackDisp(depth - 2));
+                e.callFunction(binaryHelper(ins.op));
+                depth--;
+                break;
+            case OpCode::NEG:
+                e.movRaxImm(0x8000000000000000ULL);
+                e.movqXmm1Rax();
+                e.raw({0x66, 0x0F, 0x57, 0xC1});  // xorpd xmm0, xmm1
+                break;
+            case OpCode::SQRT:
+                e.raw({0xF2, 0x0F, 0x51, 0xC0});  // sqrtsd xmm0, xmm0 (correctly rounded, like std::sqrt)
+                break;
+            case OpCode::SIN:
+            case OpCode::COS:
+            case OpCode::EXP:
+            case OpCode::LOG:
+            case OpCode::SIN_FAST:
+            case OpCode::COS_FAST:
+                e.callFunction(unaryHelper(ins.op));
+                break;
+            case OpCode::DROP:
+                // The value below, if any, becomes the top
+                if (depth > 1) e.sdStack(0x10, stackDisp(depth - 2));  // movsd xmm0, [rsp+..]
+                depth--;
+                break;
+            default:
+                return false;
+        }
+    }
+    if (depth != 1) return false;
+
+    e.raw({0x48, 0x81, 0xC4}); e.imm32(static_cast<int32_t>(frame));  // add rsp, frame
+    e.raw({0x5B});  // pop rbx
+    e.raw({0xC3});  // ret
+    return true;
+}
+
+} // namespace
+
+CodeChunk::~CodeChunk() {
+    munmap(memory, size);
+}
+
+bool JitCompiler::isSupported() {
+    return true;
+}
+
+std::shared_ptr<const JitCode> JitCompiler::compile(const CompiledExpr& program) {
+    Emitter emitter;
+    if (program.code.empty() || !generate(program, emitter)) return nullptr;
+    size_t length = emitter.bytes.size();
+
+    // Start a new chunk when the code does not fit; code larger than a chunk gets its own.
+    // Unused pages stay inaccessible.
+    size_t pageSize = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+    size_t start = (used + 15) & ~static_cast<size_t>(15);  // entry points 16-byte aligned
+    if (!chunk || start + length > chunk->size) {
+        size_t size = std::max(CHUNK_SIZE, (length + pageSize - 1) / pageSize * pageSize);
+        void* memory = mmap(nullptr, size, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (memory == MAP_FAILED) return nullptr;
+        chunk = std::make_shared<const CodeChunk>(memory, size);
+        start = 0;
+    }
+
+    // Make the pages the code lands on writable, write it, then flip them back to
+    // read+execute. Those pages may already hold other programs' code; nothing runs it
+    // meanwhile, as this compiler's programs are only executed on the compiling thread.
+    uint8_t* base = static_cast<uint8_t*>(chunk->memory);
+    size_t firstPage = start / pageSize * pageSize;
+    size_t endPage = (start + length + pageSize - 1) / pageSize * pageSize;
+    if (mprotect(base + firstPage, endPage - firstPage, PROT_READ | PROT_WRITE) != 0) return nullptr;
+    std::memcpy(base + start, emitter.bytes.data(), length);
+    if (mprotect(base + firstPage, endPage - firstPage, PROT_READ | PROT_EXEC) != 0) {
+        chunk.reset();  // leave the pages unusable rather than writable and executable
+        return nullptr;
+    }
+    used = start + length;
+
+    std::vector<int> reads;
+    int storeSlot = -1;
+    for (const Instruction& ins : program.code) {
+        if (ins.op == OpCode::LOAD_VAR && std::find(reads.begin(), reads.end(), ins.arg) == reads.end())
+            reads.push_back(ins.arg);
+        if (ins.op == OpCode::STORE_VAR) storeSlot = ins.arg;
+    }
+    return std::make_shared<const JitCode>(chunk, base + start, std::move(reads), storeSlot);
+}
+
+#else // !JIT_X86_64
+
+CodeChunk::~CodeChunk() {}
+
+bool JitCompiler::isSupported() {
+    return false;
+}
+
+std::shared_ptr<const JitCode> JitCompiler::compile(const CompiledExpr&) {
+    return nullptr;
+}
+
+#endif
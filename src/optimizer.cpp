@@ -0,0 +1,183 @@
+#include "optimizer.h"
+#include <charconv>
+#include <cmath>
+#include <cstring>
+#include "fast_trig.h"
+#include "function_table.h"
+
+namespace {
+
+double foldUnary(OpCode op, double a) {
+    switch (op) {
+        case OpCode::NEG: return -a;
+        case OpCode::SIN: return std::sin(a);
+        case OpCode::COS: return std::cos(a);
+        case OpCode::SQRT: return std::sqrt(a);
+        case OpCode::EXP: return std::exp(a);
+        case OpCode::LOG: return std::log(a);
+        case OpCode::SIN_FAST: return FastTrig::sin(a);
+        case OpCode::COS_FAST: return FastTrig::cos(a);
+        default: return a;
+    }
+}
+
+double foldBinary(OpCode op, double a, double b) {
+    switch (op) {
+        case OpCode::ADD: return a + b;
+        case OpCode::SUB: return a - b;
+        case OpCode::MUL: return a * b;
+        case OpCode::DIV: return a / b;
+        case OpCode::POW: return std::pow(a, b);
+        case OpCode::MIN: return FunctionTable::min(a, b);
+        case OpCode::MAX: return FunctionTable::max(a, b);
+        case OpCode::ATAN2: return std::atan2(a, b);
+        default: return a;
+    }
+}
+
+bool isBinary(OpCode op) {
+    return op == OpCode::ADD || op == OpCode::SUB || op == OpCode::MUL ||
+           op == OpCode::DIV || op == OpCode::POW || op == OpCode::MIN || op == OpCode::MAX ||
+           op == OpCode::ATAN2;
+}
+
+bool isPositiveZero(double v) {
+    return v == 0.0 && !std::signbit(v);
+}
+
+// Right operand that leaves the left operand unchanged bit for bit
+bool isRightIdentity(OpCode op, double v) {
+    switch (op) {
+        case OpCode::MUL:
+        case OpCode::DIV:
+        case OpCode::POW: return v == 1.0;
+        case OpCode::SUB: return isPositiveZero(v);
+        default: return false;
+    }
+}
+
+size_t maxStackDepth(const std::vector<Instruction>& code) {
+    size_t depth = 0, deepest = 0;
+    for (const Instruction& ins : code) {
+        depth += stackEffect(ins.op);
+        if (depth > deepest) deepest = depth;
+    }
+    return deepest;
+}
+
+} // namespace
+
+void Optimizer::optimize(CompiledExpr& program) {
+    std::vector<Instruction>& code = program.code;
+    segments.clear();
+    size_t out = 0;  // write position; never passes the read position
+
+    for (size_t in = 0; in < code.size(); in++) {
+        Instruction ins = code[in];
+
+        if (ins.op == OpCode::PUSH_CONST) {
+            segments.push_back(Segment{out, true, ins.value});
+            code[out++] = ins;
+            continue;
+        }
+        if (ins.op == OpCode::LOAD_VAR) {
+            segments.push_back(Segment{out, false, 0.0});
+            code[out++] = ins;
+            continue;
+        }
+        if (ins.op == OpCode::STORE_VAR) {
+            segments.back().isConst = false;  // the store must still run
+            code[out++] = ins;
+            continue;
+        }
+        if (ins.op == OpCode::DROP) {
+            Segment dropped = segments.back();
+            segments.pop_back();
+            if (dropped.isConst) {
+                out = dropped.start;  // nothing to check: remove the value with the DROP
+            } else {
+                // The read must still run, so the value below cannot be folded over it
+                if (!segments.empty()) segments.back().isConst = false;
+                code[out++] = ins;
+            }
+            continue;
+        }
+        if (!isBinary(ins.op)) {
+            Segment& operand = segments.back();
+            if (operand.isConst) {
+                operand.value = foldUnary(ins.op, operand.value);
+                out = operand.start;
+                code[out++] = Instruction{OpCode::PUSH_CONST, 0, operand.value};
+            } else {
+                code[out++] = ins;
+            }
+            continue;
+        }
+
+        Segment rhs = segments.back();
+        segments.pop_back();
+        Segment& lhs = segments.back();
+
+        if (lhs.isConst && rhs.isConst) {
+            lhs.value = foldBinary(ins.op, lhs.value, rhs.value);
+            out = lhs.start;
+            code[out++] = Instruction{OpCode::PUSH_CONST, 0, lhs.value};
+        } else if (rhs.isConst && isRightIdentity(ins.op, rhs.value)) {
+            out = rhs.start;  // drop the operand and the operator
+        } else if (lhs.isConst && ins.op == OpCode::MUL && lhs.value == 1.0) {
+            // 1 * x: move x's code down over the constant
+            size_t length = out - rhs.start;
+            std::memmove(&code[lhs.start], &code[rhs.start], length * sizeof(Instruction));
+            out = lhs.start + length;
+            lhs.isConst = false;
+        } else {
+            lhs.isConst = false;
+            code[out++] = ins;
+        }
+    }
+
+    code.resize(out);
+    program.maxStack = maxStackDepth(code);
+}
+
+std::string Optimizer::formatTree(const CompiledExpr& program, const SymbolTable& symbols) {
+    std::vector<std::string> stack;
+
+    for (const Instruction& ins : program.code) {
+        switch (ins.op) {
+            case OpCode::PUSH_CONST: {
+                char buffer[64];
+                auto result = std::to_chars(buffer, buffer + sizeof(buffer), ins.value);
+                stack.emplace_back(buffer, result.ptr);
+                break;
+            }
+            case OpCode::LOAD_VAR:
+                stack.push_back(symbols.name(ins.arg));
+                break;
+            case OpCode::STORE_VAR:
+                stack.back() = "(= " + symbols.name(ins.arg) + " " + stack.back() + ")";
+                break;
+            case OpCode::NEG: stack.back() = "(neg " + stack.back() + ")"; break;
+            case OpCode::SIN: stack.back() = "(sin " + stack.back() + ")"; break;
+            case OpCode::COS: stack.back() = "(cos " + stack.back() + ")"; break;
+            case OpCode::SQRT: stack.back() = "(sqrt " + stack.back() + ")"; break;
+            case OpCode::EXP: stack.back() = "(exp " + stack.back() + ")"; break;
+            case OpCode::LOG: stack.back() = "(log " + stack.back() + ")"; break;
+            case OpCode::SIN_FAST: stack.back() = "(sin_fast " + stack.back() + ")"; break;
+            case OpCode::COS_FAST: stack.back() = "(cos_fast " + stack.back() + ")"; break;
+            case OpCode::DROP: stack.pop_back(); break;
+            default: {
+                const char* name = ins.op == OpCode::ADD ? "+" : ins.op == OpCode::SUB ? "-" :
+                                   ins.op == OpCode::MUL ? "*" : ins.op == OpCode::DIV ? "/" :
+                                   ins.op == OpCode::MIN ? "min" : ins.op == OpCode::MAX ? "max" :
+                                   ins.op == OpCode::ATAN2 ? "atan2" : "^";
+                std::string rhs = std::move(stack.back());
+                stack.pop_back();
+                stack.back() = std::string("(") + name + " " + stack.back() + " " + rhs + ")";
+                break;
+            }
+        }
+    }
+
+    return stack.empty() ? std::string() : stack.back();
+}
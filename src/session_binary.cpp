@@ -0,0 +1,497 @@
+#include "session_binary.h"
+#include "stats.h"
+#include "text_utils.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <fstream>
+#include <limits>
+#include <stdexcept>
+#include <unordered_map>
+
+using namespace SessionBinaryFormat;
+
+namespace {
+
+uint32_t fit32(size_t value) {
+    if (value > std::numeric_limits<uint32_t>::max()) {
+        throw std::runtime_error("Input too large for the binary session format");
+    }
+    return static_cast<uint32_t>(value);
+}
+
+// Append a section of records at the next 8-byte boundary and return its offset
+template <typename Record>
+uint64_t appendSection(std::string& out, const Record* records, size_t count) {
+    out.resize((out.size() + 7) & ~size_t(7), '\0');
+    uint64_t offset = out.size();
+    out.append(reinterpret_cast<const char*>(records), count * sizeof(Record));
+    return offset;
+}
+
+// Unsigned LEB128: seven bits per byte, low bits first, high bit set on all but the last
+void appendVarint(std::string& out, uint64_t value) {
+    while (value >= 0x80) {
+        out.push_back(static_cast<char>(value | 0x80));
+        value >>= 7;
+    }
+    out.push_back(static_cast<char>(value));
+}
+
+// Read a varint at pos; false if it runs past the end of data or does not fit 32 bits
+bool readVarint(std::string_view data, size_t& pos, uint32_t& value) {
+    uint64_t result = 0;
+    for (int shift = 0; shift < 35; shift += 7) {
+        if (pos >= data.size()) return false;
+        uint8_t byte = static_cast<uint8_t>(data[pos++]);
+        result |= uint64_t(byte & 0x7f) << shift;
+        if (!(byte & 0x80)) {
+            value = static_cast<uint32_t>(result);
+            return result <= std::numeric_limits<uint32_t>::max();
+        }
+    }
+    return false;
+}
+
+// readVarint() for code that load() has already validated
+inline uint32_t decodeVarint(const char* data, size_t& pos) {
+    uint32_t value = 0;
+    for (int shift = 0; ; shift += 7) {
+        uint8_t byte = static_cast<uint8_t>(data[pos++]);
+        value |= uint32_t(byte & 0x7f) << shift;
+        if (!(byte & 0x80)) return value;
+    }
+}
+
+// Operand stack effect of an instruction, and how many values it needs on the stack
+bool stackEffect(OpCode op, int& effect, int& needs) {
+    switch (op) {
+        case OpCode::PUSH_CONST:
+        case OpCode::LOAD_VAR:  effect = 1;  needs = 0; return true;
+        case OpCode::STORE_VAR:
+        case OpCode::NEG:
+        case OpCode::SIN:
+        case OpCode::COS:
+        case OpCode::SQRT:
+        case OpCode::EXP:
+        case OpCode::LOG:
+        case OpCode::SIN_FAST:
+        case OpCode::COS_FAST:  effect = 0;  needs = 1; return true;
+        case OpCode::ADD:
+        case OpCode::SUB:
+        case OpCode::MUL:
+        case OpCode::DIV:
+        case OpCode::POW:
+        case OpCode::MIN:
+        case OpCode::MAX:
+        case OpCode::ATAN2:     effect = -1; needs = 2; return true;
+        case OpCode::DROP:      effect = -1; needs = 1; return true;
+    }
+    return false;
+}
+
+} // namespace
+
+bool SessionBinary::isBinaryFile(const std::string& filename) {
+    std::ifstream input(filename, std::ios::binary);
+    char magic[sizeof(MAGIC)];
+    return input.read(magic, sizeof(magic)) && std::memcmp(magic, MAGIC, sizeof(MAGIC)) == 0;
+}
+
+std::string SessionBinary::fromText(std::string_view text) {
+    fit32(text.size());
+    std::string lineTable;
+    std::string sessionTable;
+    std::string scopeTable;
+    std::string code;
+    std::vector<double> constantPool;
+    std::unordered_map<uint64_t, uint32_t> constantIndex;  // by bit pattern, so -0.0 and NaNs stay distinct
+    uint32_t lineCount = 0;
+    uint32_t scopeCount = 1;  // scope 0: lines before the first "----"
+    size_t previousEnd = 0;
+
+    // PUSH_CONST operand: whole numbers below 2^31 inline, anything else from the pool
+    auto constant = [&](double value) {
+        if (value >= 0.0 && value < 2147483648.0 && value == std::floor(value) && !std::signbit(value)) {
+            return static_cast<uint32_t>(value) << 1 | 1;
+        }
+        uint64_t bits;
+        std::memcpy(&bits, &value, sizeof(bits));
+        auto entry = constantIndex.emplace(bits, fit32(constantPool.size()));
+        if (entry.second) constantPool.push_back(value);
+        return fit32(uint64_t(entry.first->second) << 1);
+    };
+
+    // Each scope numbers its own names from 0, but functions stay defined across "----", as
+    // they do for the calculator reading the text. sessionEvaluator forgets them at each
+    // "----", as session_analyzer does; it only compiles lines that call or define a function.
+    Evaluator evaluator;
+    Evaluator sessionEvaluator;
+    CompiledExpr program;
+    CompiledExpr sessionProgram;
+    auto closeScope = [&] {
+        const SymbolTable& names = evaluator.getSymbols();
+        appendVarint(scopeTable, names.size());
+        for (size_t slot = 0; slot < names.size(); slot++) {
+            std::string_view name = names.name(static_cast<int>(slot));
+            appendVarint(scopeTable, name.size());
+            scopeTable.append(name);
+        }
+    };
+
+    std::string_view line;
+    size_t pos = 0;
+    while (TextUtils::nextLine(text, pos, line)) {
+        line = TextUtils::trim(line);
+        if (line.empty()) continue;
+        size_t offset = static_cast<size_t>(line.data() - text.data());
+        appendVarint(lineTable, offset - previousEnd);
+        appendVarint(lineTable, line.size());
+        previousEnd = offset + line.size();
+        lineCount++;
+
+        if (TextUtils::isSessionSeparator(line)) {
+            closeScope();
+            evaluator.resetVariables();
+            sessionEvaluator.reset();
+            scopeCount++;
+            appendVarint(lineTable, SEPARATOR);
+            continue;
+        }
+
+        std::string error;
+        try {
+            evaluator.compile(line, program);
+        } catch (const std::exception& e) {
+            error = e.what();
+        }
+        std::string sessionError;
+        if (program.features & (FEATURE_FUNCTION_CALL | FEATURE_DEFINITION)) {
+            try {
+                sessionEvaluator.compile(line, sessionProgram);
+            } catch (const std::exception& e) {
+                if (e.what() != error) sessionError = e.what();
+            }
+        }
+        uint32_t flags = sessionError.empty() ? 0 : HAS_SESSION_ERROR;
+
+        size_t codeStart = code.size();
+        if (!error.empty()) {
+            appendVarint(lineTable, SYNTAX_ERROR | flags | program.features << 4);
+            appendVarint(lineTable, 0);
+            code.append(error);
+            appendVarint(lineTable, code.size() - codeStart);
+            if (flags) {
+                appendVarint(lineTable, sessionError.size());
+                code.append(sessionError);
+            }
+            continue;
+        }
+
+        for (const Instruction& ins : program.code) {
+            code.push_back(static_cast<char>(ins.op));
+            if (ins.op == OpCode::PUSH_CONST) {
+                appendVarint(code, constant(ins.value));
+            } else if (ins.op == OpCode::LOAD_VAR || ins.op == OpCode::STORE_VAR) {
+                appendVarint(code, fit32(static_cast<size_t>(ins.arg)));
+            }
+        }
+
+        LineKind kind = ASSIGNMENT;
+        if (!(program.features & FEATURE_ASSIGNMENT)) {
+            kind = EXPRESSION;
+        } else if (program.code.size() == 2 && program.code[0].op == OpCode::PUSH_CONST &&
+                   program.code[1].op == OpCode::STORE_VAR) {
+            kind = CONSTANT_ASSIGNMENT;
+        }
+        appendVarint(lineTable, kind | flags | program.features << 4);
+        appendVarint(lineTable, program.maxStack);
+        appendVarint(lineTable, code.size() - codeStart);
+        if (flags) {
+            appendVarint(lineTable, sessionError.size());
+            code.append(sessionError);
+        }
+    }
+    closeScope();
+    fit32(code.size());
+
+    uint32_t sessionCount = 0;
+    SessionStream stream(text);
+    for (SessionSpan span{}; stream.next(span); sessionCount++) {
+        appendVarint(sessionTable, static_cast<uint32_t>(span.sessionNumber));
+        appendVarint(sessionTable, fit32(span.firstLine));
+        appendVarint(sessionTable, static_cast<uint32_t>(span.variableCount));
+        appendVarint(sessionTable, static_cast<uint32_t>(span.expressionCount));
+    }
+
+    Header header{};
+    std::memcpy(header.magic, MAGIC, sizeof(MAGIC));
+    header.version = VERSION;
+    header.byteOrder = BYTE_ORDER_MARK;
+    header.lineCount = lineCount;
+    header.sessionCount = sessionCount;
+    header.scopeCount = scopeCount;
+    header.constantCount = constantPool.size();
+    header.textBytes = text.size();
+    header.lineBytes = lineTable.size();
+    header.sessionBytes = sessionTable.size();
+    header.scopeBytes = scopeTable.size();
+    header.codeBytes = code.size();
+
+    std::string out(sizeof(Header), '\0');
+    header.constantsOffset = appendSection(out, constantPool.data(), constantPool.size());
+    header.textOffset = appendSection(out, text.data(), text.size());
+    header.linesOffset = appendSection(out, lineTable.data(), lineTable.size());
+    header.sessionsOffset = appendSection(out, sessionTable.data(), sessionTable.size());
+    header.scopesOffset = appendSection(out, scopeTable.data(), scopeTable.size());
+    header.codeOffset = appendSection(out, code.data(), code.size());
+    std::memcpy(&out[0], &header, sizeof(header));
+    return out;
+}
+
+void SessionBinary::load(const std::string& filename) {
+    if (!file.open(filename)) {
+        throw std::runtime_error("Error: could not open file: " + filename);
+    }
+    std::string_view contents = file.contents();
+    Stats::addBytes(Stats::READ, contents.size());
+
+    auto corrupt = [&filename](const char* what) {
+        return std::runtime_error("Corrupt session file " + filename + ": " + what);
+    };
+
+    if (contents.size() < sizeof(Header) || std::memcmp(contents.data(), MAGIC, sizeof(MAGIC)) != 0) {
+        throw std::runtime_error("Not a binary session file: " + filename);
+    }
+    header = reinterpret_cast<const Header*>(contents.data());
+    if (header->version != VERSION) {
+        throw std::runtime_error("Unsupported session file version " + std::to_string(header->version) +
+                                 " in " + filename + " (expected " + std::to_string(VERSION) + ")");
+    }
+    if (header->byteOrder != BYTE_ORDER_MARK) {
+        throw std::runtime_error("Session file " + filename + " was written with a different byte order");
+    }
+
+    // Sections must be aligned and lie entirely within the file
+    auto section = [&](uint64_t offset, uint64_t count, size_t recordSize, const char* name) {
+        if (offset % 8 != 0 || offset > contents.size() || count > (contents.size() - offset) / recordSize) {
+            throw corrupt(name);
+        }
+        return contents.data() + offset;
+    };
+    auto table = [&](uint64_t offset, uint64_t bytes, const char* name) {
+        return std::string_view(section(offset, bytes, 1, name), bytes);
+    };
+    constants = reinterpret_cast<const double*>(
+        section(header->constantsOffset, header->constantCount, sizeof(double), "constants out of bounds"));
+    textData = section(header->textOffset, header->textBytes, 1, "text out of bounds");
+    std::string_view lineTable = table(header->linesOffset, header->lineBytes, "line table out of bounds");
+    std::string_view sessionTable = table(header->sessionsOffset, header->sessionBytes, "session table out of bounds");
+    std::string_view scopeTable = table(header->scopesOffset, header->scopeBytes, "scope table out of bounds");
+    codeData = section(header->codeOffset, header->codeBytes, 1, "code out of bounds");
+    // Offsets into text and code are 32-bit, and every record takes at least a byte
+    // per field, so the counts cannot ask for more records than the tables hold
+    if (header->textBytes > std::numeric_limits<uint32_t>::max() ||
+        header->codeBytes > std::numeric_limits<uint32_t>::max() ||
+        header->lineCount > header->lineBytes / 3 || header->sessionCount > header->sessionBytes / 4 ||
+        header->scopeCount == 0 || header->scopeCount > header->scopeBytes) {
+        throw corrupt("record counts out of bounds");
+    }
+
+    auto next = [&corrupt](std::string_view records, size_t& pos, const char* what) {
+        uint32_t value;
+        if (!readVarint(records, pos, value)) throw corrupt(what);
+        return value;
+    };
+
+    scopes.clear();
+    symbols.clear();
+    size_t pos = 0;
+    for (uint32_t i = 0; i < header->scopeCount; i++) {
+        ScopeRecord scope{static_cast<uint32_t>(symbols.size()), next(scopeTable, pos, "scope table truncated")};
+        for (uint32_t symbol = 0; symbol < scope.symbolCount; symbol++) {
+            uint32_t length = next(scopeTable, pos, "scope table truncated");
+            if (length > scopeTable.size() - pos) throw corrupt("symbol name out of bounds");
+            symbols.push_back(scopeTable.substr(pos, length));
+            pos += length;
+        }
+        scopes.push_back(scope);
+    }
+    if (pos != scopeTable.size()) throw corrupt("scope table has trailing bytes");
+
+    sessionRecords.clear();
+    sessionRecords.reserve(header->sessionCount);
+    pos = 0;
+    for (uint32_t i = 0; i < header->sessionCount; i++) {
+        SessionRecord s;
+        s.sessionNumber = next(sessionTable, pos, "session table truncated");
+        s.firstLine = next(sessionTable, pos, "session table truncated");
+        s.variableCount = next(sessionTable, pos, "session table truncated");
+        s.expressionCount = next(sessionTable, pos, "session table truncated");
+        if (s.expressionCount > 1 || uint64_t(s.firstLine) + s.variableCount + s.expressionCount > header->lineCount) {
+            throw corrupt("session lines out of bounds");
+        }
+        sessionRecords.push_back(s);
+    }
+    if (pos != sessionTable.size()) throw corrupt("session table has trailing bytes");
+
+    lines.clear();
+    lines.reserve(header->lineCount);
+    expressions = 0;
+    pos = 0;
+    uint64_t textEnd = 0;
+    uint64_t codeEnd = 0;
+    uint32_t scope = 0;
+    for (uint32_t i = 0; i < header->lineCount; i++) {
+        Line line{};
+        uint64_t start = textEnd + next(lineTable, pos, "line table truncated");
+        uint32_t length = next(lineTable, pos, "line table truncated");
+        if (start > header->textBytes || length > header->textBytes - start) throw corrupt("line text out of bounds");
+        line.textOffset = static_cast<uint32_t>(start);
+        line.textLength = length;
+        textEnd = start + length;
+
+        uint32_t kindAndFeatures = next(lineTable, pos, "line table truncated");
+        if ((kindAndFeatures & 7) > SYNTAX_ERROR) throw corrupt("unknown line kind");
+        line.kind = static_cast<LineKind>(kindAndFeatures & 7);
+        line.features = kindAndFeatures >> 4;
+        if (line.kind == SEPARATOR) scope++;
+        if (scope >= header->scopeCount) throw corrupt("line scope out of bounds");
+        line.scope = scope;
+
+        if (line.kind != SEPARATOR) {
+            expressions++;
+            line.maxStack = next(lineTable, pos, "line table truncated");
+            line.codeLength = next(lineTable, pos, "line table truncated");
+            if (line.codeLength > header->codeBytes - codeEnd) throw corrupt("code out of bounds");
+            line.codeOffset = static_cast<uint32_t>(codeEnd);
+            codeEnd += line.codeLength;
+            if (kindAndFeatures & HAS_SESSION_ERROR) {
+                line.sessionErrorLength = next(lineTable, pos, "line table truncated");
+                if (line.sessionErrorLength == 0 || line.sessionErrorLength > header->codeBytes - codeEnd) {
+                    throw corrupt("session error out of bounds");
+                }
+                codeEnd += line.sessionErrorLength;
+            }
+            if (line.kind != SYNTAX_ERROR) {
+                line.instructions = validateProgram(line, filename);
+            }
+            if (line.kind == CONSTANT_ASSIGNMENT) {
+                // PUSH_CONST <operand>, STORE_VAR <slot>
+                std::string_view bytes = code(line);
+                size_t storeAt = 1;
+                uint32_t operand;
+                if (line.instructions != 2 || uint8_t(bytes[0]) != uint8_t(OpCode::PUSH_CONST) ||
+                    !readVarint(bytes, storeAt, operand) || uint8_t(bytes[storeAt]) != uint8_t(OpCode::STORE_VAR)) {
+                    throw corrupt("constant assignment is not PUSH_CONST, STORE_VAR");
+                }
+            }
+        }
+        lines.push_back(line);
+    }
+    if (pos != lineTable.size()) throw corrupt("line table has trailing bytes");
+    if (codeEnd != header->codeBytes) throw corrupt("code has trailing bytes");
+}
+
+uint32_t SessionBinary::validateProgram(const Line& line, const std::string& filename) const {
+    std::string_view bytes = code(line);
+    uint32_t symbolCount = scopes[line.scope].symbolCount;
+    int64_t depth = 0;
+    int64_t deepest = 0;
+    uint32_t count = 0;
+    for (size_t pos = 0; pos < bytes.size(); count++) {
+        int effect = 0;
+        int needs = 0;
+        OpCode op = static_cast<OpCode>(static_cast<uint8_t>(bytes[pos++]));
+        bool valid = stackEffect(op, effect, needs) && depth >= needs;
+        uint32_t arg = 0;
+        if (op == OpCode::LOAD_VAR || op == OpCode::STORE_VAR) {
+            valid = valid && readVarint(bytes, pos, arg) && arg < symbolCount;
+        } else if (op == OpCode::PUSH_CONST) {
+            valid = valid && readVarint(bytes, pos, arg) && ((arg & 1) || (arg >> 1) < header->constantCount);
+        }
+        if (!valid) throw std::runtime_error("Corrupt session file " + filename + ": invalid program");
+        depth += effect;
+        deepest = std::max(deepest, depth);
+    }
+    // maxStack sizes the evaluator's stack, so it is trusted only as far as the code needs
+    if (depth != 1 || deepest > line.maxStack || line.maxStack > count) {
+        throw std::runtime_error("Corrupt session file " + filename + ": invalid program");
+    }
+    return count;
+}
+
+void SessionBinary::session(size_t index, Session& session) const {
+    const SessionRecord& record = sessionRecords[index];
+    session.sessionNumber = static_cast<int>(record.sessionNumber);
+    session.variableCount = static_cast<int>(record.variableCount);
+    session.expressionCount = static_cast<int>(record.expressionCount);
+    session.firstLine = record.firstLine;
+    session.variables.clear();
+    session.expressions.clear();
+    for (uint32_t v = 0; v < record.variableCount; v++) {
+        session.variables.emplace_back(lineText(record.firstLine + v));
+    }
+    if (record.expressionCount) {
+        session.expressions.emplace_back(lineText(record.firstLine + record.variableCount));
+    }
+}
+
+void SessionBinary::bindScope(uint32_t scope, Evaluator& evaluator, std::vector<int>& slots) const {
+    const ScopeRecord& record = scopes[scope];
+    slots.resize(record.symbolCount);
+    for (uint32_t i = 0; i < record.symbolCount; i++) {
+        slots[i] = evaluator.internVariable(symbols[record.firstSymbol + i]);
+    }
+}
+
+double SessionBinary::run(size_t line, Evaluator& evaluator, const std::vector<int>& slots,
+                          CompiledExpr& program) const {
+    if (Stats::enabled()) {
+        Stats::Timer timer(Stats::EVALUATE);
+        return runLine(line, evaluator, slots, program);
+    }
+    return runLine(line, evaluator, slots, program);
+}
+
+double SessionBinary::runLine(size_t line, Evaluator& evaluator, const std::vector<int>& slots,
+                              CompiledExpr& program) const {
+    const Line& record = lines[line];
+    switch (record.kind) {
+        case SYNTAX_ERROR:
+            throw std::runtime_error(std::string(code(record)));
+        case SEPARATOR:
+            throw std::logic_error("A session separator is not an expression");
+        case CONSTANT_ASSIGNMENT: {
+            const char* bytes = codeData + record.codeOffset;
+            size_t pos = 1;  // past PUSH_CONST
+            double value = constant(decodeVarint(bytes, pos));
+            pos++;           // past STORE_VAR
+            evaluator.setVariable(symbols[scopes[record.scope].firstSymbol + decodeVarint(bytes, pos)], value);
+            return value;
+        }
+        default:
+            loadProgram(record, slots, program);
+            return evaluator.execute(program);
+    }
+}
+
+void SessionBinary::loadProgram(const Line& line, const std::vector<int>& slots,
+                                CompiledExpr& program) const {
+    const char* bytes = codeData + line.codeOffset;
+    size_t pos = 0;
+    program.code.resize(line.instructions);
+    for (Instruction& ins : program.code) {
+        ins.op = static_cast<OpCode>(static_cast<uint8_t>(bytes[pos++]));
+        ins.arg = 0;
+        ins.value = 0.0;
+        if (ins.op == OpCode::PUSH_CONST) ins.value = constant(decodeVarint(bytes, pos));
+        else if (ins.op == OpCode::LOAD_VAR || ins.op == OpCode::STORE_VAR) ins.arg = slots[decodeVarint(bytes, pos)];
+    }
+    program.maxStack = line.maxStack;
+    program.features = line.features;
+    // A different program each time: never let tiering state carry over
+    program.executions = 0;
+    program.jitAttempted = false;
+    program.jit.reset();
+}
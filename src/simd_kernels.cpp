@@ -0,0 +1,221 @@
+#include "simd_kernels.h"
+#include <cmath>
+#include "fast_trig.h"
+#include "function_table.h"
+
+#if defined(__x86_64__) || defined(_M_X64)
+#define SIMD_KERNELS_X86 1
+#include <immintrin.h>
+#endif
+
+namespace {
+
+#ifdef SIMD_KERNELS_X86
+
+bool hasAvx2() {
+    static const bool supported = __builtin_cpu_supports("avx2");
+    return supported;
+}
+
+// Defines an SSE2 and an AVX2 version of a binary kernel plus a scalar tail
+#define DEFINE_BINARY_KERNEL(NAME, SSE_OP, AVX_OP, SCALAR_OP)                 \
+    void NAME##Sse2(double* a, const double* b, size_t n) {                  \
+        size_t i = 0;                                                        \
+        for (; i + 2 <= n; i += 2) {                                         \
+            __m128d x = _mm_loadu_pd(a + i);                                 \
+            __m128d y = _mm_loadu_pd(b + i);                                 \
+            _mm_storeu_pd(a + i, SSE_OP(x, y));                              \
+        }                                                                    \
+        for (; i < n; i++) a[i] = a[i] SCALAR_OP b[i];                       \
+    }                                                                        \
+    __attribute__((target("avx2")))                                          \
+    void NAME##Avx2(double* a, const double* b, size_t n) {                  \
+        size_t i = 0;                                                        \
+        for (; i + 4 <= n; i += 4) {                                         \
+            __m256d x = _mm256_loadu_pd(a + i);                              \
+            __m256d y = _mm256_loadu_pd(b + i);                              \
+            _mm256_storeu_pd(a + i, AVX_OP(x, y));                           \
+        }                                                                    \
+        for (; i < n; i++) a[i] = a[i] SCALAR_OP b[i];                       \
+    }
+
+DEFINE_BINARY_KERNEL(add, _mm_add_pd, _mm256_add_pd, +)
+DEFINE_BINARY_KERNEL(sub, _mm_sub_pd, _mm256_sub_pd, -)
+DEFINE_BINARY_KERNEL(mul, _mm_mul_pd, _mm256_mul_pd, *)
+DEFINE_BINARY_KERNEL(div, _mm_div_pd, _mm256_div_pd, /)
+
+#undef DEFINE_BINARY_KERNEL
+
+void negSse2(double* a, size_t n) {
+    const __m128d signMask = _mm_set1_pd(-0.0);
+    size_t i = 0;
+    for (; i + 2 <= n; i += 2) {
+        _mm_storeu_pd(a + i, _mm_xor_pd(_mm_loadu_pd(a + i), signMask));
+    }
+    for (; i < n; i++) a[i] = -a[i];
+}
+
+__attribute__((target("avx2")))
+void negAvx2(double* a, size_t n) {
+    const __m256d signMask = _mm256_set1_pd(-0.0);
+    size_t i = 0;
+    for (; i + 4 <= n; i += 4) {
+        _mm256_storeu_pd(a + i, _mm256_xor_pd(_mm256_loadu_pd(a + i), signMask));
+    }
+    for (; i < n; i++) a[i] = -a[i];
+}
+
+void sqrtSse2(double* a, size_t n) {
+    size_t i = 0;
+    for (; i + 2 <= n; i += 2) _mm_storeu_pd(a + i, _mm_sqrt_pd(_mm_loadu_pd(a + i)));
+    for (; i < n; i++) a[i] = std::sqrt(a[i]);
+}
+
+__attribute__((target("avx2")))
+void sqrtAvx2(double* a, size_t n) {
+    size_t i = 0;
+    for (; i + 4 <= n; i += 4) _mm256_storeu_pd(a + i, _mm256_sqrt_pd(_mm256_loadu_pd(a + i)));
+    for (; i < n; i++) a[i] = std::sqrt(a[i]);
+}
+
+// Lanes FastTrig computes itself; the others go to libm
+inline __m128d sse2TrigInRange(__m128d x) {
+    return _mm_cmple_pd(_mm_andnot_pd(_mm_set1_pd(-0.0), x), _mm_set1_pd(FastTrig::MAX_ARGUMENT));
+}
+
+__attribute__((target("avx2")))
+inline __m256d avx2TrigInRange(__m256d x) {
+    return _mm256_cmp_pd(_mm256_andnot_pd(_mm256_set1_pd(-0.0), x), _mm256_set1_pd(FastTrig::MAX_ARGUMENT),
+                         _CMP_LE_OQ);
+}
+
+// Defines FastTrig::kernel for one vector width: the same operations in the same order,
+// with k mod 4 taken from the low bits of `shifted` and applied through masks instead
+// of branches. quarterTurns is 0 for sin and 1 for cos. PREFIX and SI name the
+// intrinsics of the width (_mm/si128, _mm256/si256).
+#define DEFINE_FAST_TRIG_KERNEL(ISA, ATTR, VEC, IVEC, WIDTH, PREFIX, SI)                   \
+    ATTR void ISA##FastTrig(double* a, size_t n, unsigned quarterTurns) {                  \
+        static const double SIN_COEFFICIENTS[] = {FastTrig::S5, FastTrig::S4, FastTrig::S3, \
+                                                  FastTrig::S2, FastTrig::S1};             \
+        static const double COS_COEFFICIENTS[] = {FastTrig::C5, FastTrig::C4, FastTrig::C3, \
+                                                  FastTrig::C2, FastTrig::C1};             \
+        const VEC rounder = PREFIX##_set1_pd(FastTrig::ROUNDER);                           \
+        const IVEC turns = PREFIX##_set1_epi64x(quarterTurns);                             \
+        const IVEC one = PREFIX##_set1_epi64x(1);                                          \
+        const IVEC two = PREFIX##_set1_epi64x(2);                                          \
+        size_t i = 0;                                                                      \
+        for (; i + WIDTH <= n; i += WIDTH) {                                               \
+            VEC x = PREFIX##_loadu_pd(a + i);                                              \
+            VEC shifted = PREFIX##_add_pd(PREFIX##_mul_pd(x, PREFIX##_set1_pd(FastTrig::TWO_OVER_PI)), rounder); \
+            VEC k = PREFIX##_sub_pd(shifted, rounder);                                     \
+            IVEC quadrant = PREFIX##_add_epi64(PREFIX##_castpd_##SI(shifted), turns);      \
+                                                                                           \
+            VEC r = PREFIX##_sub_pd(x, PREFIX##_mul_pd(k, PREFIX##_set1_pd(FastTrig::PIO2_HI))); \
+            r = PREFIX##_sub_pd(r, PREFIX##_mul_pd(k, PREFIX##_set1_pd(FastTrig::PIO2_MID))); \
+            r = PREFIX##_sub_pd(r, PREFIX##_mul_pd(k, PREFIX##_set1_pd(FastTrig::PIO2_LO))); \
+            VEC z = PREFIX##_mul_pd(r, r);                                                 \
+            VEC ps = PREFIX##_set1_pd(FastTrig::S6);                                       \
+            VEC pc = PREFIX##_set1_pd(FastTrig::C6);                                       \
+            for (int j = 0; j < 5; j++) {                                                  \
+                ps = PREFIX##_add_pd(PREFIX##_set1_pd(SIN_COEFFICIENTS[j]), PREFIX##_mul_pd(z, ps)); \
+                pc = PREFIX##_add_pd(PREFIX##_set1_pd(COS_COEFFICIENTS[j]), PREFIX##_mul_pd(z, pc)); \
+            }                                                                              \
+            VEC s = PREFIX##_add_pd(r, PREFIX##_mul_pd(PREFIX##_mul_pd(r, z), ps));        \
+            VEC c = PREFIX##_sub_pd(PREFIX##_set1_pd(1.0), PREFIX##_mul_pd(PREFIX##_set1_pd(0.5), z)); \
+            c = PREFIX##_add_pd(c, PREFIX##_mul_pd(PREFIX##_mul_pd(z, z), pc));            \
+                                                                                           \
+            /* all ones where k is odd, and the sign bit where k & 2 */                    \
+            VEC odd = PREFIX##_cast##SI##_pd(                                              \
+                PREFIX##_sub_epi64(PREFIX##_setzero_##SI(), PREFIX##_and_##SI(quadrant, one))); \
+            VEC sign = PREFIX##_cast##SI##_pd(PREFIX##_slli_epi64(PREFIX##_and_##SI(quadrant, two), 62)); \
+            VEC v = PREFIX##_or_pd(PREFIX##_and_pd(odd, c), PREFIX##_andnot_pd(odd, s));   \
+            PREFIX##_storeu_pd(a + i, PREFIX##_xor_pd(v, sign));                           \
+                                                                                           \
+            int inRange = PREFIX##_movemask_pd(ISA##TrigInRange(x));                       \
+            if (inRange != (1 << WIDTH) - 1) {                                             \
+                double lanes[WIDTH];                                                       \
+                PREFIX##_storeu_pd(lanes, x);                                              \
+                for (int j = 0; j < WIDTH; j++) {                                          \
+                    if (!(inRange >> j & 1)) a[i + j] = quarterTurns ? std::cos(lanes[j]) : std::sin(lanes[j]); \
+                }                                                                          \
+            }                                                                              \
+        }                                                                                  \
+        for (; i < n; i++) a[i] = quarterTurns ? FastTrig::cos(a[i]) : FastTrig::sin(a[i]); \
+    }
+
+DEFINE_FAST_TRIG_KERNEL(sse2, , __m128d, __m128i, 2, _mm, si128)
+DEFINE_FAST_TRIG_KERNEL(avx2, __attribute__((target("avx2"))), __m256d, __m256i, 4, _mm256, si256)
+
+#undef DEFINE_FAST_TRIG_KERNEL
+
+#endif // SIMD_KERNELS_X86
+
+} // namespace
+
+namespace SimdKernels {
+
+#ifdef SIMD_KERNELS_X86
+
+void add(double* a, const double* b, size_t n) { hasAvx2() ? addAvx2(a, b, n) : addSse2(a, b, n); }
+void sub(double* a, const double* b, size_t n) { hasAvx2() ? subAvx2(a, b, n) : subSse2(a, b, n); }
+void mul(double* a, const double* b, size_t n) { hasAvx2() ? mulAvx2(a, b, n) : mulSse2(a, b, n); }
+void div(double* a, const double* b, size_t n) { hasAvx2() ? divAvx2(a, b, n) : divSse2(a, b, n); }
+void neg(double* a, size_t n) { hasAvx2() ? negAvx2(a, n) : negSse2(a, n); }
+void sqrt(double* a, size_t n) { hasAvx2() ? sqrtAvx2(a, n) : sqrtSse2(a, n); }
+void sinFast(double* a, size_t n) { hasAvx2() ? avx2FastTrig(a, n, 0) : sse2FastTrig(a, n, 0); }
+void cosFast(double* a, size_t n) { hasAvx2() ? avx2FastTrig(a, n, 1) : sse2FastTrig(a, n, 1); }
+
+const char* activeIsa() { return hasAvx2() ? "avx2" : "sse2"; }
+
+#else
+
+void add(double* a, const double* b, size_t n) { for (size_t i = 0; i < n; i++) a[i] += b[i]; }
+void sub(double* a, const double* b, size_t n) { for (size_t i = 0; i < n; i++) a[i] -= b[i]; }
+void mul(double* a, const double* b, size_t n) { for (size_t i = 0; i < n; i++) a[i] *= b[i]; }
+void div(double* a, const double* b, size_t n) { for (size_t i = 0; i < n; i++) a[i] /= b[i]; }
+void neg(double* a, size_t n) { for (size_t i = 0; i < n; i++) a[i] = -a[i]; }
+void sqrt(double* a, size_t n) { for (size_t i = 0; i < n; i++) a[i] = std::sqrt(a[i]); }
+void sinFast(double* a, size_t n) { for (size_t i = 0; i < n; i++) a[i] = FastTrig::sin(a[i]); }
+void cosFast(double* a, size_t n) { for (size_t i = 0; i < n; i++) a[i] = FastTrig::cos(a[i]); }
+
+const char* activeIsa() { return "scalar"; }
+
+#endif
+
+void pow(double* a, const double* b, size_t n) {
+    for (size_t i = 0; i < n; i++) a[i] = std::pow(a[i], b[i]);
+}
+
+void min(double* a, const double* b, size_t n) {
+    for (size_t i = 0; i < n; i++) a[i] = FunctionTable::min(a[i], b[i]);
+}
+
+void max(double* a, const double* b, size_t n) {
+    for (size_t i = 0; i < n; i++) a[i] = FunctionTable::max(a[i], b[i]);
+}
+
+void atan2(double* a, const double* b, size_t n) {
+    for (size_t i = 0; i < n; i++) a[i] = std::atan2(a[i], b[i]);
+}
+
+void sin(double* a, size_t n) {
+    for (size_t i = 0; i < n; i++) a[i] = std::sin(a[i]);
+}
+
+void cos(double* a, size_t n) {
+    for (size_t i = 0; i < n; i++) a[i] = std::cos(a[i]);
+}
+
+void exp(double* a, size_t n) {
+    for (size_t i = 0; i < n; i++) a[i] = std::exp(a[i]);
+}
+
+void log(double* a, size_t n) {
+    for (size_t i = 0; i < n; i++) a[i] = std::log(a[i]);
+}
+
+void fill(double* a, double value, size_t n) {
+    for (size_t i = 0; i < n; i++) a[i] = value;
+}
+
+} // namespace SimdKernels
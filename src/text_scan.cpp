@@ -0,0 +1,180 @@
+#include "text_scan.h"
+
+#if defined(__x86_64__) || defined(_M_X64)
+#define TEXT_SCAN_X86 1
+#include <immintrin.h>
+#endif
+
+namespace {
+
+using TextScan::CharClass;
+
+// Plain loops: the tails of the vector scans, and everything on other targets
+size_t skipRunScalar(const char* data, size_t size, size_t pos, CharClass cls) {
+    while (pos < size && TextScan::is(data[pos], cls)) ++pos;
+    return pos;
+}
+
+size_t skipRunBackScalar(const char* data, size_t end, CharClass cls) {
+    while (end > 0 && TextScan::is(data[end - 1], cls)) --end;
+    return end;
+}
+
+size_t findByteScalar(const char* data, size_t size, size_t pos, char byte) {
+    while (pos < size && data[pos] != byte) ++pos;
+    return pos;
+}
+
+#ifdef TEXT_SCAN_X86
+
+bool avx2Enabled = true;  // TextScan::setAvx2Enabled
+
+bool hasAvx2() {
+    static const bool supported = __builtin_cpu_supports("avx2");
+    return supported && avx2Enabled;
+}
+
+// Defines, for one vector width, a class test and the forward, backward and byte
+// scans built on it. A class test is a few byte compares: c - lo <= hi - lo (unsigned,
+// via min) for ranges, and c | 0x20 folds A-Z onto a-z for the letter ranges.
+// MASK turns a compare result into one bit per byte.
+#define DEFINE_SCANS(ISA, ATTR, VEC, WIDTH, LOAD, SET1, SUB, MIN_U8, CMPEQ, OR, MASK)      \
+    ATTR inline VEC ISA##Range(VEC v, char lo, char hi) {                               \
+        VEC offset = SUB(v, SET1(lo));                                                  \
+        return CMPEQ(MIN_U8(offset, SET1(static_cast<char>(hi - lo))), offset);         \
+    }                                                                                   \
+    ATTR inline VEC ISA##Equal(VEC v, char c) { return CMPEQ(v, SET1(c)); }             \
+    ATTR inline uint32_t ISA##Members(const char* p, CharClass cls) {                   \
+        VEC v = LOAD(reinterpret_cast<const VEC*>(p));                                  \
+        VEC folded = OR(v, SET1(0x20));                                                 \
+        VEC in;                                                                         \
+        switch (cls) {                                                                  \
+            case TextScan::SPACE:                                                       \
+                in = OR(ISA##Equal(v, ' '), ISA##Range(v, '\t', '\r'));                 \
+                break;                                                                  \
+            case TextScan::LINE_SPACE:                                                  \
+                in = OR(OR(ISA##Equal(v, ' '), ISA##Equal(v, '\t')),                    \
+                        OR(ISA##Equal(v, '\r'), ISA##Equal(v, '\n')));                  \
+                break;                                                                  \
+            case TextScan::DIGIT:                                                       \
+                in = ISA##Range(v, '0', '9');                                           \
+                break;                                                                  \
+            case TextScan::HEX_DIGIT:                                                   \
+                in = OR(ISA##Range(v, '0', '9'), ISA##Range(folded, 'a', 'f'));         \
+                break;                                                                  \
+            case TextScan::ALPHA:                                                       \
+                in = ISA##Range(folded, 'a', 'z');                                      \
+                break;                                                                  \
+            case TextScan::IDENTIFIER:                                                  \
+                in = OR(OR(ISA##Range(v, '0', '9'), ISA##Range(folded, 'a', 'z')),      \
+                        ISA##Equal(v, '_'));                                            \
+                break;                                                                  \
+            case TextScan::DECIMAL:                                                     \
+                in = OR(ISA##Range(v, '0', '9'), ISA##Equal(v, '.'));                   \
+                break;                                                                  \
+            default:                                                                    \
+                in = ISA##Range(v, '0', '1');                                           \
+                break;                                                                  \
+        }                                                                               \
+        return static_cast<uint32_t>(MASK(in));                                         \
+    }                                                                                   \
+    ATTR uint32_t ISA##Outside(const char* p, CharClass cls) {                          \
+        return ~ISA##Members(p, cls) & static_cast<uint32_t>((1ULL << WIDTH) - 1);      \
+    }                                                                                   \
+    ATTR uint32_t ISA##Matches(const char* p, char byte) {                              \
+        return static_cast<uint32_t>(MASK(ISA##Equal(LOAD(reinterpret_cast<const VEC*>(p)), byte))); \
+    }
+
+DEFINE_SCANS(sse2, , __m128i, 16, _mm_loadu_si128, _mm_set1_epi8, _mm_sub_epi8,
+             _mm_min_epu8, _mm_cmpeq_epi8, _mm_or_si128, _mm_movemask_epi8)
+DEFINE_SCANS(avx2, __attribute__((target("avx2"))), __m256i, 32, _mm256_loadu_si256,
+             _mm256_set1_epi8, _mm256_sub_epi8, _mm256_min_epu8, _mm256_cmpeq_epi8,
+             _mm256_or_si256, _mm256_movemask_epi8)
+
+#undef DEFINE_SCANS
+
+// Defines the forward, backward and byte scans for one vector width. Forward scans
+// take whole blocks, then one last block that overlaps bytes already scanned (shifted
+// out of the mask), so only text shorter than a block is scanned byte by byte. Each
+// width finishes on its own: the AVX2 scans never call into SSE2 code, which would
+// run legacy SSE instructions with the upper halves of the ymm registers dirty.
+#define DEFINE_RUNS(ISA, ATTR, WIDTH)                                                    \
+    ATTR size_t ISA##SkipRun(const char* data, size_t size, size_t pos, CharClass cls) { \
+        for (; pos + WIDTH <= size; pos += WIDTH) {                                      \
+            if (uint32_t outside = ISA##Outside(data + pos, cls)) return pos + __builtin_ctz(outside); \
+        }                                                                                \
+        if (pos == size) return pos;                                                     \
+        if (size < WIDTH) return skipRunScalar(data, size, pos, cls);                    \
+        size_t block = size - WIDTH;                                                     \
+        uint32_t outside = ISA##Outside(data + block, cls) >> (pos - block);             \
+        return outside ? pos + __builtin_ctz(outside) : size;                            \
+    }                                                                                    \
+    ATTR size_t ISA##SkipRunBack(const char* data, size_t end, CharClass cls) {          \
+        for (; end >= WIDTH; end -= WIDTH) {                                             \
+            if (uint32_t outside = ISA##Outside(data + end - WIDTH, cls)) {              \
+                return end - WIDTH + (32 - __builtin_clz(outside));                      \
+            }                                                                            \
+        }                                                                                \
+        return skipRunBackScalar(data, end, cls);                                        \
+    }                                                                                    \
+    ATTR size_t ISA##FindByte(const char* data, size_t size, size_t pos, char byte) {    \
+        for (; pos + WIDTH <= size; pos += WIDTH) {                                      \
+            if (uint32_t found = ISA##Matches(data + pos, byte)) return pos + __builtin_ctz(found); \
+        }                                                                                \
+        if (pos == size) return pos;                                                     \
+        if (size < WIDTH) return findByteScalar(data, size, pos, byte);                  \
+        size_t block = size - WIDTH;                                                     \
+        uint32_t found = ISA##Matches(data + block, byte) >> (pos - block);              \
+        return found ? pos + __builtin_ctz(found) : size;                                \
+    }
+
+DEFINE_RUNS(sse2, , 16)
+DEFINE_RUNS(avx2, __attribute__((target("avx2"))), 32)
+
+#undef DEFINE_RUNS
+
+#endif // TEXT_SCAN_X86
+
+} // namespace
+
+namespace TextScan {
+
+#ifdef TEXT_SCAN_X86
+
+size_t skipRun(const char* data, size_t size, size_t pos, CharClass cls) {
+    return hasAvx2() ? avx2SkipRun(data, size, pos, cls) : sse2SkipRun(data, size, pos, cls);
+}
+
+size_t skipRunBack(const char* data, size_t end, CharClass cls) {
+    return hasAvx2() ? avx2SkipRunBack(data, end, cls) : sse2SkipRunBack(data, end, cls);
+}
+
+size_t findByte(const char* data, size_t size, size_t pos, char byte) {
+    return hasAvx2() ? avx2FindByte(data, size, pos, byte) : sse2FindByte(data, size, pos, byte);
+}
+
+const char* activeIsa() { return hasAvx2() ? "avx2" : "sse2"; }
+
+void setAvx2Enabled(bool enabled) { avx2Enabled = enabled; }
+
+#else
+
+size_t skipRun(const char* data, size_t size, size_t pos, CharClass cls) {
+    return skipRunScalar(data, size, pos, cls);
+}
+
+size_t skipRunBack(const char* data, size_t end, CharClass cls) {
+    return skipRunBackScalar(data, end, cls);
+}
+
+size_t findByte(const char* data, size_t size, size_t pos, char byte) {
+    return findByteScalar(data, size, pos, byte);
+}
+
+const char* activeIsa() { return "scalar"; }
+
+void setAvx2Enabled(bool) {}
+
+#endif
+
+} // namespace TextScan
@@ -0,0 +1,63 @@
+// Evaluating an expression must not touch the heap once the evaluator's buffers
+// have grown: literals are converted in place with from_chars, names are looked up
+// without building strings, and programs and stacks are reused.
+
+#include <atomic>
+#include <cstdlib>
+#include <new>
+#include <string_view>
+#include "check.h"
+#include "evaluator.h"
+
+static std::atomic<size_t> allocationCount{0};
+
+void* operator new(size_t size) {
+    allocationCount.fetch_add(1, std::memory_order_relaxed);
+    if (void* p = std::malloc(size ? size : 1)) return p;
+    throw std::bad_alloc();
+}
+void operator delete(void* p) noexcept { std::free(p); }
+void operator delete(void* p, size_t) noexcept { std::free(p); }
+
+const std::string_view EXPRESSIONS[] = {
+    "radius = 5",
+    "pi = 3.14159",
+    "area = pi * radius ^ 2",
+    "1 + 2 * 3 - 4 / 5",
+    "-(2.5 + 0.25) * 4",
+    "0xFF + 0x1A - 1100b",
+    "area / 2 + radius",
+    "2 ^ 3 ^ 2",
+    "sin(radius) * cos(pi / 3)",
+    "sqrt(area) + exp(1) + log(radius)",
+    "pow(2, 10) + min(radius, 3) + max(1, 2) + atan2(1, 2)",
+    "radius = radius + 1",
+};
+
+// Allocations made by evaluating every expression `rounds` times
+size_t allocationsPerRun(Evaluator& evaluator, int rounds) {
+    size_t before = allocationCount.load(std::memory_order_relaxed);
+    for (int round = 0; round < rounds; round++) {
+        for (std::string_view expression : EXPRESSIONS) evaluator.evaluate(expression);
+    }
+    return allocationCount.load(std::memory_order_relaxed) - before;
+}
+
+int main() {
+    // Every expression compiled and run from scratch: the lexer and parser path
+    {
+        Evaluator evaluator;
+        evaluator.setCacheCapacity(0);
+        allocationsPerRun(evaluator, 3);  // warm-up: symbols interned, buffers grown
+        CHECK(allocationsPerRun(evaluator, 100) == 0);
+    }
+
+    // The same with the result cache on, so repeats are answered from it
+    {
+        Evaluator evaluator;
+        allocationsPerRun(evaluator, 3);
+        CHECK(allocationsPerRun(evaluator, 100) == 0);
+    }
+
+    return CHECK_RESULT();
+}
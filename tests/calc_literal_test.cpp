@@ -0,0 +1,79 @@
+// _calc literals are parsed and, where the formula only uses operations the compiler
+// can evaluate, computed at compile time: the static_asserts below are checked by
+// building this file. main() then checks that the same formulas give the runtime
+// Evaluator's results bit for bit.
+
+#include <cmath>
+#include <cstring>
+#include <string_view>
+#include "calc_literal.h"
+#include "check.h"
+#include "evaluator.h"
+
+using namespace CalcLiterals;
+using ConstexprCalc::NodeKind;
+
+// Constant formulas
+static_assert("1 + 2 * 3"_calc() == 7.0);
+static_assert("(1 + 2) * 3"_calc() == 9.0);
+static_assert("10 - 4 - 3"_calc() == 3.0);  // left-associative
+static_assert("-2.5 * 4"_calc() == -10.0);
+static_assert("0xFF + 101b"_calc() == 260.0);
+static_assert("0x1a * 10b"_calc() == 52.0);
+static_assert(" 7 / 2 "_calc() == 3.5);
+
+// Variables are call arguments in order of first appearance
+constexpr auto ratio = "(p + q) * r / (p - q)"_calc;
+static_assert(decltype(ratio)::arity == 3);
+static_assert(decltype(ratio)::variable(0) == "p");
+static_assert(decltype(ratio)::variable(1) == "q");
+static_assert(decltype(ratio)::variable(2) == "r");
+static_assert(ratio(3.0, 1.0, 2.0) == 4.0);
+static_assert("x * x - y"_calc(4.0, 6.0) == 10.0);
+static_assert("-(a - b)"_calc(1.0, 3.0) == 2.0);
+
+// ^ is right-associative: 2 ^ 3 ^ 2 parses as 2 ^ (3 ^ 2)
+constexpr auto power = "2 ^ 3 ^ 2"_calc;
+constexpr ConstexprCalc::Node powerRoot = decltype(power)::program.nodes[decltype(power)::program.root];
+static_assert(powerRoot.kind == NodeKind::POW);
+static_assert(decltype(power)::program.nodes[powerRoot.lhs].kind == NodeKind::NUMBER);
+static_assert(decltype(power)::program.nodes[powerRoot.rhs].kind == NodeKind::POW);
+
+// Function calls resolve through FunctionTable
+constexpr auto distance = "sqrt(a * a + b * b) + min(a, b)"_calc;
+static_assert(decltype(distance)::arity == 2);
+static_assert(decltype(distance)::program.nodes[decltype(distance)::program.root].kind == NodeKind::ADD);
+
+bool sameBits(double a, double b) {
+    return std::memcmp(&a, &b, sizeof(double)) == 0;
+}
+
+int main() {
+    Evaluator evaluator;
+    evaluator.setVariable("p", 3.0);
+    evaluator.setVariable("q", 1.25);
+    evaluator.setVariable("r", -2.0);
+    evaluator.setVariable("a", 0.3);
+    evaluator.setVariable("b", 1.7);
+
+    CHECK(sameBits(ratio(3.0, 1.25, -2.0), evaluator.evaluate("(p + q) * r / (p - q)")));
+    CHECK(sameBits(power(), evaluator.evaluate("2 ^ 3 ^ 2")));
+    CHECK(sameBits(distance(0.3, 1.7), evaluator.evaluate("sqrt(a * a + b * b) + min(a, b)")));
+    CHECK(sameBits("sin(a) * cos(b) - exp(-a) / log(b) + atan2(a, b)"_calc(0.3, 1.7),
+                   evaluator.evaluate("sin(a) * cos(b) - exp(-a) / log(b) + atan2(a, b)")));
+    CHECK(sameBits("-a ^ 2 + 0x10 ^ 0.5"_calc(0.3), evaluator.evaluate("-a ^ 2 + 0x10 ^ 0.5")));
+
+    // std::pow(d, 2) and d * d differ in the last bit here; a literal folded at compile
+    // time and the same formula on a variable must both give pow's result
+    // (the exponent is volatile so the compiler cannot rewrite the reference as d * d)
+    const double d = 3762.3682180706942;
+    volatile double two = 2.0;
+    const double expected = std::pow(d, two);
+    CHECK(!sameBits(expected, d * d));
+    evaluator.setVariable("d", d);
+    CHECK(sameBits(evaluator.evaluate("3762.3682180706942 ^ 2"), expected));
+    CHECK(sameBits(evaluator.evaluate("d ^ 2"), expected));
+    CHECK(sameBits("d ^ 2"_calc(d), expected));
+
+    return CHECK_RESULT();
+}
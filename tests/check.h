@@ -0,0 +1,24 @@
+#ifndef CHECK_H
+#define CHECK_H
+
+#include <iostream>
+
+// Minimal assertions for the test programs in tests/. A failed CHECK prints the
+// condition and where it failed, and the test keeps going; main returns
+// CHECK_RESULT(), which is non-zero if any check failed.
+namespace Check {
+    inline int failures = 0;
+}
+
+#define CHECK(condition)                                                              \
+    do {                                                                              \
+        if (!(condition)) {                                                           \
+            Check::failures++;                                                        \
+            std::cerr << __FILE__ << ":" << __LINE__ << ": CHECK failed: " #condition \
+                      << std::endl;                                                   \
+        }                                                                             \
+    } while (0)
+
+#define CHECK_RESULT() (Check::failures == 0 ? 0 : 1)
+
+#endif // CHECK_H
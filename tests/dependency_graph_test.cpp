@@ -0,0 +1,106 @@
+// DependencyGraph: only formulas downstream of a changed variable are recomputed,
+// each after the formulas it reads, and definitions that close a cycle are rejected.
+
+#include <stdexcept>
+#include <string>
+#include "check.h"
+#include "dependency_graph.h"
+
+// Message of the exception thrown by define(), or "" if it succeeded
+std::string defineError(DependencyGraph& sheet, const std::string& statement) {
+    try {
+        sheet.define(statement);
+    } catch (const std::exception& e) {
+        return e.what();
+    }
+    return "";
+}
+
+int main() {
+    // Recompute order: a chain and a diamond give the right values only if every
+    // formula runs after the formulas it reads
+    {
+        Evaluator evaluator;
+        DependencyGraph sheet(evaluator);
+        sheet.assign("a", 1);
+        sheet.assign("other", 100);
+        size_t b = sheet.define("b = a * 2");
+        size_t c = sheet.define("c = b + a");
+        size_t d = sheet.define("d = c * b");
+        size_t e = sheet.define("d - c + b");
+        size_t unrelated = sheet.define("other + 1");
+        CHECK(sheet.value(d) == 6);   // c = 3, b = 2
+
+        CHECK(sheet.assign("a", 5) == 4);  // b, c, d and the anonymous formula; not `unrelated`
+        CHECK(sheet.value(b) == 10);
+        CHECK(sheet.value(c) == 15);
+        CHECK(sheet.value(d) == 150);
+        CHECK(sheet.value(e) == 145);
+        CHECK(sheet.value(unrelated) == 101);
+        CHECK(evaluator.getVariables().at("d") == 150);
+
+        CHECK(sheet.assign("other", 1) == 1);
+        CHECK(sheet.value(unrelated) == 2);
+    }
+
+    // Redefining a derived variable replaces its formula and updates its readers
+    {
+        Evaluator evaluator;
+        DependencyGraph sheet(evaluator);
+        sheet.assign("pi", 3);
+        sheet.assign("radius", 2);
+        size_t area = sheet.define("area = pi * radius ^ 2");
+        size_t twice = sheet.define("area * 2");
+        CHECK(sheet.value(twice) == 24);
+        CHECK(sheet.define("area = radius") == area);
+        CHECK(sheet.value(twice) == 4);
+        CHECK(sheet.assign("pi", 10) == 0);  // the old formula no longer reads pi
+        CHECK(sheet.assign("radius", 3) == 2);
+        CHECK(sheet.value(twice) == 6);
+
+        // Assigning a derived variable directly detaches its formula
+        sheet.assign("area", 50);
+        CHECK(sheet.value(twice) == 100);
+        CHECK(sheet.assign("radius", 4) == 0);
+
+        // Neither redefinitions nor detached formulas grow the graph
+        for (int i = 0; i < 100; i++) {
+            sheet.define("area = radius * " + std::to_string(i));
+            sheet.assign("area", i);
+        }
+        CHECK(sheet.size() == 2);
+        CHECK(sheet.value(twice) == 198);
+    }
+
+    // Evaluation errors are kept per formula and cleared once the input exists
+    {
+        Evaluator evaluator;
+        DependencyGraph sheet(evaluator);
+        size_t missing = sheet.define("later + 1");
+        CHECK(sheet.hasError(missing));
+        CHECK(sheet.error(missing) == "Undefined variable: later");
+        sheet.assign("later", 1);
+        CHECK(!sheet.hasError(missing));
+        CHECK(sheet.value(missing) == 2);
+    }
+
+    // Cycles are rejected with the path that closes them, and leave the graph unchanged
+    {
+        Evaluator evaluator;
+        DependencyGraph sheet(evaluator);
+        sheet.assign("y", 1);
+        size_t x = sheet.define("x = y + 1");
+        CHECK(defineError(sheet, "y = x * 2") == "Dependency cycle: y -> x -> y");
+        CHECK(defineError(sheet, "z = z + 1") == "Dependency cycle: z -> z");
+
+        sheet.define("w = x * 10");
+        CHECK(defineError(sheet, "y = w - 1") == "Dependency cycle: y -> w -> x -> y");
+        CHECK(sheet.size() == 2);
+
+        CHECK(sheet.assign("y", 4) == 2);
+        CHECK(sheet.value(x) == 5);
+        CHECK(evaluator.getVariables().at("w") == 50);
+    }
+
+    return CHECK_RESULT();
+}
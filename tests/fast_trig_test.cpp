@@ -0,0 +1,64 @@
+// FastTrig::sin and cos stay within the error bound stated in fast_trig.h, measured
+// against a long double reference over random arguments in each range, half of them
+// just off a multiple of pi/2 where the argument reduction matters most.
+
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+#include <limits>
+#include <random>
+#include "check.h"
+#include "fast_trig.h"
+
+// Distance from result to the reference value in units of the reference's last place
+double ulpError(double result, long double reference) {
+    double rounded = static_cast<double>(reference);
+    if (rounded == 0.0) return result == 0.0 ? 0.0 : std::numeric_limits<double>::infinity();
+    long double ulp = std::ldexp(1.0L, std::ilogb(rounded) - 52);
+    return static_cast<double>(std::fabs(static_cast<long double>(result) - reference) / ulp);
+}
+
+bool sameValue(double a, double b) {
+    return a == b || (std::isnan(a) && std::isnan(b));
+}
+
+int main() {
+    struct Range {
+        double limit;
+        double bound;  // ulp
+    };
+    const Range ranges[] = {{10.0, 1.6}, {1000.0, 2.0}, {FastTrig::MAX_ARGUMENT, 2.5}};
+
+    std::mt19937_64 generator(24);
+    for (const Range& range : ranges) {
+        std::uniform_real_distribution<double> uniform(-range.limit, range.limit);
+        double worstSin = 0.0;
+        double worstCos = 0.0;
+        for (int i = 0; i < 1000000; i++) {
+            double x = uniform(generator);
+            if (i & 1) {
+                // Up to 2^-20 away from the double nearest a multiple of pi/2
+                double k = std::nearbyint(x / (M_PI / 2));
+                double offset = std::ldexp(static_cast<double>(generator() % 2001) - 1000.0,
+                                           -30 - static_cast<int>(generator() % 20));
+                x = k * (M_PI / 2) + offset;
+                if (!(std::fabs(x) <= range.limit)) continue;
+            }
+            worstSin = std::max(worstSin, ulpError(FastTrig::sin(x), sinl(static_cast<long double>(x))));
+            worstCos = std::max(worstCos, ulpError(FastTrig::cos(x), cosl(static_cast<long double>(x))));
+        }
+        std::cout << "|x| <= " << range.limit << ": sin " << worstSin << " ulp, cos " << worstCos
+                  << " ulp (bound " << range.bound << ")" << std::endl;
+        CHECK(worstSin <= range.bound);
+        CHECK(worstCos <= range.bound);
+    }
+
+    // Outside the polynomial's range the results are libm's
+    const double inf = std::numeric_limits<double>::infinity();
+    for (double x : {2e6, -1e300, inf, -inf, std::numeric_limits<double>::quiet_NaN()}) {
+        CHECK(sameValue(FastTrig::sin(x), std::sin(x)));
+        CHECK(sameValue(FastTrig::cos(x), std::cos(x)));
+    }
+
+    return CHECK_RESULT();
+}
@@ -0,0 +1,97 @@
+// Differential test of the JIT tier against the interpreter: random expressions over
+// every operator and function, run on both with variable values that include signed
+// zeros, infinities and NaNs of both signs, must give bit-identical results.
+
+#include <cmath>
+#include <cstring>
+#include <iostream>
+#include <limits>
+#include <random>
+#include <string>
+#include <vector>
+#include "check.h"
+#include "evaluator.h"
+
+std::mt19937 generator(2024);
+
+std::string pick(std::initializer_list<const char*> choices) {
+    return *(choices.begin() + generator() % choices.size());
+}
+
+std::string expression(int depth) {
+    int kind = generator() % 12;
+    if (depth <= 0 || kind < 3) {
+        return pick({"x", "y", "z", "n", "m", "1.5", "0", "3", "0.25", "1000", "0x1F", "101b", "700000"});
+    }
+    if (kind < 5) return pick({"sin", "cos", "sqrt", "exp", "log"}) + "(" + expression(depth - 1) + ")";
+    if (kind < 7) {
+        return pick({"pow", "min", "max", "atan2"}) + "(" + expression(depth - 1) + ", " +
+               expression(depth - 1) + ")";
+    }
+    if (kind < 8) return "-" + expression(depth - 1);
+    return "(" + expression(depth - 1) + " " + pick({"+", "-", "*", "/", "^"}) + " " +
+           expression(depth - 1) + ")";
+}
+
+bool sameBits(double a, double b) {
+    return std::memcmp(&a, &b, sizeof(double)) == 0;
+}
+
+int main() {
+    if (!JitCompiler::isSupported()) {
+        std::cout << "JIT not supported on this platform; skipped" << std::endl;
+        return 0;
+    }
+
+    const double nan = std::numeric_limits<double>::quiet_NaN();
+    const double inf = std::numeric_limits<double>::infinity();
+    const double values[] = {0.0, -0.0, 1.0, -2.5, 0.001, 123456.789, -1e300, 1e-310,
+                             inf, -inf, nan, -nan, 3.14159, -0.75, 2e6, 42.0};
+
+    size_t checks = 0;
+    size_t mismatches = 0;
+    for (TrigAccuracy accuracy : {TrigAccuracy::EXACT, TrigAccuracy::FAST}) {
+        Evaluator interpreter;
+        Evaluator native;
+        interpreter.setJitEnabled(false);
+        native.setJitThreshold(0);
+        interpreter.setTrigAccuracy(accuracy);
+        native.setTrigAccuracy(accuracy);
+
+        for (int i = 0; i < 5000; i++) {
+            // Every fourth program also assigns its result, to cover STORE_VAR
+            std::string text = expression(1 + generator() % 5);
+            if (i % 4 == 0) text = "result = " + text;
+            CompiledExpr interpreted = interpreter.compile(text);
+            CompiledExpr compiled = native.compile(text);
+
+            for (size_t v = 0; v < sizeof(values) / sizeof(values[0]); v++) {
+                // n and m are NaNs of opposite sign, so operand order shows in the result
+                for (Evaluator* evaluator : {&interpreter, &native}) {
+                    evaluator->setVariable("x", values[v]);
+                    evaluator->setVariable("y", values[(v * 7 + 3) % 16]);
+                    evaluator->setVariable("z", values[(v * 5 + 11) % 16]);
+                    evaluator->setVariable("n", nan);
+                    evaluator->setVariable("m", -nan);
+                }
+                double expected = interpreter.execute(interpreted);
+                double actual = native.execute(compiled);
+                checks++;
+                bool same = sameBits(expected, actual);
+                if (same && i % 4 == 0) {
+                    same = sameBits(interpreter.getVariables().at("result"),
+                                    native.getVariables().at("result"));
+                }
+                if (!same && mismatches++ < 10) {
+                    std::cerr << "mismatch: " << text << " with x = " << values[v] << ": interpreter "
+                              << expected << ", JIT " << actual << std::endl;
+                }
+            }
+            CHECK(compiled.jit != nullptr);
+        }
+    }
+
+    std::cout << checks << " checks, " << mismatches << " mismatches" << std::endl;
+    CHECK(mismatches == 0);
+    return CHECK_RESULT();
+}
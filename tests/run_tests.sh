@@ -0,0 +1,20 @@
+#!/bin/sh
+# Build every tests/*_test.cpp together with src/*.cpp and run it.
+# Usage: tests/run_tests.sh [test_name...]   (default: all tests)
+# Exits non-zero as soon as a test fails to build or fails.
+set -e
+cd "$(dirname "$0")/.."
+CXX=${CXX:-g++}
+BUILD_DIR=${BUILD_DIR:-${TMPDIR:-/tmp}/calculator_tests}
+mkdir -p "$BUILD_DIR"
+
+if [ $# -eq 0 ]; then
+    set -- $(ls tests/*_test.cpp | sed 's|tests/||; s|\.cpp$||')
+fi
+
+for name in "$@"; do
+    echo "== $name"
+    $CXX -std=c++17 -O2 -Wall -Wextra -I./include -pthread -o "$BUILD_DIR/$name" "tests/$name.cpp" src/*.cpp
+    "$BUILD_DIR/$name"
+done
+echo "All tests passed"
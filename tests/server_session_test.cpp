@@ -0,0 +1,52 @@
+// ServerSession::consume gives the same responses however the request stream is split
+// into reads, answers an over-long line once with an error, and never buffers more than
+// one line.
+
+#include <random>
+#include <string>
+#include "check.h"
+#include "server_session.h"
+
+// Responses to `stream` delivered in pieces of at most maxPiece bytes
+std::string respond(const std::string& stream, size_t maxPiece, std::mt19937& generator,
+                    size_t* largestInput = nullptr) {
+    ServerSession session;
+    std::string input;
+    std::string output;
+    size_t pos = 0;
+    while (pos < stream.size()) {
+        size_t piece = 1 + generator() % maxPiece;
+        input.append(stream, pos, piece);
+        pos += piece;
+        session.consume(input, output);
+        if (largestInput && input.size() > *largestInput) *largestInput = input.size();
+    }
+    session.finish(input, output);
+    return output;
+}
+
+int main() {
+    std::mt19937 generator(7);
+    const std::string tooLong = "Error: Line longer than 65536 bytes\n";
+    const std::string longLine(ServerSession::MAX_LINE_LENGTH + 10, '1');
+
+    std::string stream = "x = 2\n\n  x * 3.5  \n----\nx\n1 +" + std::string(40000, ' ') + "1\n" +
+                         longLine + "\nundefined + 1\n" + longLine + longLine + "\n2 ^ 10";
+    std::string expected = "2\n7.00\n----\nError: Undefined variable: x\n2\n" + tooLong +
+                           "Error: Undefined variable: undefined\n" + tooLong + "1024\n";
+
+    CHECK(respond(stream, stream.size(), generator) == expected);
+    for (size_t maxPiece : {1, 2, 7, 100, 4096, 70000}) {
+        size_t largestInput = 0;
+        CHECK(respond(stream, maxPiece, generator, &largestInput) == expected);
+        CHECK(largestInput <= ServerSession::MAX_LINE_LENGTH);
+    }
+
+    // A line exactly at the limit is still evaluated, with or without its '\n'
+    std::string atLimit = "1" + std::string(ServerSession::MAX_LINE_LENGTH - 1, ' ');
+    CHECK(respond(atLimit + "\n", 1000, generator) == "1\n");
+    CHECK(respond(atLimit, 1000, generator) == "1\n");
+    CHECK(respond(atLimit + " ", 1000, generator) == tooLong);
+
+    return CHECK_RESULT();
+}
@@ -0,0 +1,93 @@
+// A binary session file gives back its source text byte for byte, runs every line to
+// the same output as the text does, stays within a small factor of the text's size,
+// and is rejected with an error when truncated.
+
+#include <cstdio>
+#include <fstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+#include "check.h"
+#include "expression_processor.h"
+#include "file_reader.h"
+#include "session_binary.h"
+
+const std::string FILENAME = "/tmp/session_binary_test.bin";
+
+void writeFile(const std::string& contents) {
+    std::ofstream output(FILENAME, std::ios::binary | std::ios::trunc);
+    output.write(contents.data(), contents.size());
+}
+
+bool sameResults(const CategoryResults& a, const CategoryResults& b) {
+    return a.basicCalc == b.basicCalc && a.hexBinary == b.hexBinary &&
+           a.variables == b.variables && a.advanced == b.advanced;
+}
+
+int main() {
+    // Blank lines, indentation, trailing blanks, CRLF and a last line without '\n'
+    const std::string text =
+        "radius = 5\n"
+        "\n"
+        "   area = 3.14159 * radius ^ 2   \n"
+        "area / 2\r\n"
+        "\t\n"
+        "  ----  \n"
+        "x = 0x1F\n"
+        "x + 101b + undefined\n"
+        "1 + * 2\n"
+        "sqrt(x) + radius";
+
+    SessionBinary binary;
+    writeFile(SessionBinary::fromText(text));
+    binary.load(FILENAME);
+    CHECK(binary.text() == text);
+    CHECK(binary.lineCount() == 8);
+    CHECK(binary.expressionCount() == 7);
+    CHECK(binary.lineText(1) == "area = 3.14159 * radius ^ 2");
+    CHECK(binary.lineText(3) == "----");
+    CHECK(binary.lineKind(3) == SessionBinaryFormat::SEPARATOR);
+    CHECK(binary.lineKind(4) == SessionBinaryFormat::CONSTANT_ASSIGNMENT);
+    CHECK(binary.lineKind(7) == SessionBinaryFormat::EXPRESSION);
+    CHECK(binary.lineText(7) == "sqrt(x) + radius");
+
+    // Same output as evaluating the text
+    std::vector<std::string_view> expressions;
+    for (size_t line = 0; line < binary.lineCount(); line++) {
+        if (binary.lineKind(line) != SessionBinaryFormat::SEPARATOR) expressions.push_back(binary.lineText(line));
+    }
+    Evaluator fromText;
+    Evaluator fromBinary;
+    CHECK(sameResults(ExpressionProcessor::processExpressions(expressions, fromText),
+                      ExpressionProcessor::processBinary(binary, fromBinary)));
+
+    // The text is kept verbatim; the varint-coded tables and programs add about as much again
+    std::string corpus;
+    for (int i = 0; i < 500; i++) {
+        std::string n = std::to_string(i);
+        corpus += "a = " + n + "\nb = a * 0x" + std::to_string(i % 90 + 10) + " - sin(a / " + n + ".5)\n" +
+                  "(a + b) ^ 2 / max(b, 1" + n + ") + cos(b)\n----\n";
+    }
+    std::string compiled = SessionBinary::fromText(corpus);
+    CHECK(compiled.size() < corpus.size() * 5 / 2);
+    writeFile(compiled);
+    binary.load(FILENAME);
+    CHECK(binary.text() == corpus);
+    CHECK(binary.sessionCount() == 500);
+
+    // Every truncation is rejected when loading, never read past
+    for (size_t size : {compiled.size() - 1, compiled.size() / 2, size_t(200), size_t(64)}) {
+        writeFile(compiled.substr(0, size));
+        bool rejected = false;
+        try {
+            SessionBinary truncated;
+            truncated.load(FILENAME);
+        } catch (const std::runtime_error&) {
+            rejected = true;
+        }
+        CHECK(rejected);
+    }
+
+    std::remove(FILENAME.c_str());
+    return CHECK_RESULT();
+}
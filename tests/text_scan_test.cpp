@@ -0,0 +1,104 @@
+// TextScan's vector scans give the same positions as a byte-at-a-time loop over the
+// class table, for every class, start and end position, and text length around the
+// 16- and 32-byte block edges. Runs with the CPU's own instruction set, then with the
+// SSE2 scans forced on an AVX2 CPU.
+
+#include <cctype>
+#include <iostream>
+#include <memory>
+#include <random>
+#include <string_view>
+#include <vector>
+#include "check.h"
+#include "text_scan.h"
+
+using TextScan::CharClass;
+
+const CharClass CLASSES[] = {TextScan::SPACE, TextScan::LINE_SPACE, TextScan::DIGIT, TextScan::HEX_DIGIT,
+                             TextScan::ALPHA, TextScan::IDENTIFIER, TextScan::DECIMAL, TextScan::BINARY_DIGIT};
+
+size_t skipReference(std::string_view text, size_t pos, CharClass cls) {
+    while (pos < text.size() && TextScan::is(text[pos], cls)) ++pos;
+    return pos;
+}
+
+size_t skipBackReference(std::string_view text, size_t end, CharClass cls) {
+    while (end > 0 && TextScan::is(text[end - 1], cls)) --end;
+    return end;
+}
+
+size_t findReference(std::string_view text, size_t pos, char byte) {
+    while (pos < text.size() && text[pos] != byte) ++pos;
+    return pos;
+}
+
+// Runs of cls members broken by single random bytes (any of the 256), so runs of
+// every length cross the block edges. Each text gets a buffer of exactly its size,
+// so a scan reading past the end shows up under AddressSanitizer.
+std::unique_ptr<char[]> makeText(std::mt19937& generator, size_t length, CharClass cls) {
+    std::vector<char> members;
+    for (int c = 0; c < 256; c++) {
+        if (TextScan::is(static_cast<char>(c), cls)) members.push_back(static_cast<char>(c));
+    }
+    auto text = std::make_unique<char[]>(length ? length : 1);
+    size_t run = 0;
+    for (size_t i = 0; i < length; i++) {
+        if (run == 0) {
+            text[i] = static_cast<char>(generator() % 256);
+            run = generator() % 48;
+        } else {
+            text[i] = members[generator() % members.size()];
+            run--;
+        }
+    }
+    return text;
+}
+
+size_t checkAll(std::mt19937& generator) {
+    size_t checks = 0;
+    for (CharClass cls : CLASSES) {
+        for (size_t length = 0; length <= 100; length++) {
+            for (int round = 0; round < 4; round++) {
+                std::unique_ptr<char[]> buffer = makeText(generator, length, cls);
+                std::string_view text(buffer.get(), length);
+                char byte = length ? text[generator() % length] : '\n';
+                for (size_t pos = 0; pos <= length; pos++) {
+                    size_t skipped = skipReference(text, pos, cls);
+                    size_t start = skipBackReference(text, pos, cls);
+                    size_t found = findReference(text, pos, byte);
+                    CHECK(TextScan::skip(text, pos, cls) == skipped);
+                    CHECK(TextScan::skipBack(text, pos, cls) == start);
+                    CHECK(TextScan::find(text, pos, byte) == found);
+                    // The vector scans directly, which the wrappers only call for long runs
+                    CHECK(TextScan::skipRun(text.data(), length, pos, cls) == skipped);
+                    CHECK(TextScan::skipRunBack(text.data(), pos, cls) == start);
+                    CHECK(TextScan::findByte(text.data(), length, pos, byte) == found);
+                    checks += 6;
+                }
+            }
+        }
+    }
+    return checks;
+}
+
+int main() {
+    // The table itself against the "C" locale classes it documents
+    for (int c = 0; c < 256; c++) {
+        char ch = static_cast<char>(c);
+        bool ascii = c < 0x80;
+        CHECK(TextScan::is(ch, TextScan::SPACE) == (ascii && std::isspace(c)));
+        CHECK(TextScan::is(ch, TextScan::DIGIT) == (ascii && std::isdigit(c)));
+        CHECK(TextScan::is(ch, TextScan::HEX_DIGIT) == (ascii && std::isxdigit(c)));
+        CHECK(TextScan::is(ch, TextScan::ALPHA) == (ascii && std::isalpha(c)));
+        CHECK(TextScan::is(ch, TextScan::IDENTIFIER) == (ascii && (std::isalnum(c) || c == '_')));
+    }
+
+    std::mt19937 generator(22);
+    std::cout << TextScan::activeIsa() << ": " << checkAll(generator) << " checks" << std::endl;
+
+    TextScan::setAvx2Enabled(false);
+    std::cout << TextScan::activeIsa() << ": " << checkAll(generator) << " checks" << std::endl;
+    TextScan::setAvx2Enabled(true);
+
+    return CHECK_RESULT();
+}
@@ -0,0 +1,166 @@
+// User-defined functions: an argument the body never reads still has its variables
+// checked, in the interpreter, the JIT, batch evaluation and binary session files;
+// functions without parameters can be defined and called as "name()"; errors that name
+// a function are counted under one kind by --stats.
+
+#include <cstdio>
+#include <fstream>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+#include "check.h"
+#include "evaluator.h"
+#include "expression_processor.h"
+#include "session_binary.h"
+#include "stats.h"
+
+// The error message of evaluating text, or "" if it succeeds
+std::string errorOf(Evaluator& evaluator, const std::string& text) {
+    try {
+        evaluator.evaluate(text);
+    } catch (const std::runtime_error& e) {
+        return e.what();
+    }
+    return "";
+}
+
+// The same for an already compiled program
+std::string errorOf(Evaluator& evaluator, const CompiledExpr& program) {
+    try {
+        evaluator.execute(program);
+    } catch (const std::runtime_error& e) {
+        return e.what();
+    }
+    return "";
+}
+
+int main() {
+    const char* definitions[] = {
+        "one(x) = 1",
+        "first(a, b) = a * 2",
+        "nested(p) = first(p, p + z)",
+        "three() = 3",
+        "scaled() = three() * factor",
+    };
+
+    Evaluator interpreter;
+    Evaluator native;
+    interpreter.setJitEnabled(false);
+    native.setJitThreshold(0);
+    for (Evaluator* evaluator : {&interpreter, &native}) {
+        for (const char* definition : definitions) CHECK(evaluator->evaluate(definition) == 0.0);
+    }
+
+    for (Evaluator* evaluator : {&interpreter, &native}) {
+        // Unused arguments: their variables must exist, their values do not matter
+        CHECK(errorOf(*evaluator, "one(undefinedVar)") == "Undefined variable: undefinedVar");
+        CHECK(errorOf(*evaluator, "first(3, nope)") == "Undefined variable: nope");
+        CHECK(errorOf(*evaluator, "nested(1)") == "Undefined variable: z");
+        CHECK(evaluator->evaluate("one(2)") == 1.0);
+        evaluator->setVariable("y", 4.0);
+        evaluator->setVariable("z", 0.5);
+        CHECK(evaluator->evaluate("one(y / 0)") == 1.0);
+        CHECK(evaluator->evaluate("first(3, y)") == 6.0);
+        CHECK(evaluator->evaluate("5 + one(y) + 2") == 8.0);
+        CHECK(evaluator->evaluate("nested(y)") == 8.0);
+
+        // No parameters
+        CHECK(evaluator->evaluate("three() + three( ) * 2") == 9.0);
+        CHECK(errorOf(*evaluator, "scaled()") == "Undefined variable: factor");
+        evaluator->setVariable("factor", 2.0);
+        CHECK(evaluator->evaluate("scaled()") == 6.0);
+        CHECK(errorOf(*evaluator, "three(1)") == "Wrong number of function arguments: three takes 0");
+        CHECK(errorOf(*evaluator, "sin()") == "Wrong number of function arguments: sin takes 1");
+        CHECK(errorOf(*evaluator, "missing()") == "Unknown function: missing");
+    }
+
+    // Errors naming a function keep the name after the ':', so --stats counts one kind for all
+    CHECK(errorOf(interpreter, "loop(x) = loop(x) + 1") == "Recursive function call: loop");
+    // Each level doubles the inlined code, so some definition passes the limit
+    std::string expandError = errorOf(interpreter, "f0(x) = x + x");
+    for (int level = 1; level <= 16 && expandError.empty(); level++) {
+        std::string previous = "f" + std::to_string(level - 1);
+        expandError = errorOf(interpreter, "f" + std::to_string(level) + "(x) = " + previous + "(x) + " +
+                                               previous + "(x)");
+    }
+    CHECK(expandError == "Function calls expand too far: more than 65536 instructions");
+    Stats::enable();
+    for (const char* text : {"sin()", "three(1)", "pow(1)"}) {
+        try {
+            interpreter.evaluate(text);
+        } catch (const std::runtime_error& e) {
+            Stats::recordError(e);
+        }
+    }
+    std::ostringstream json;
+    Stats::writeJson(json);
+    CHECK(json.str().find("\"errors\": {\"Wrong number of function arguments\": 3}") != std::string::npos);
+
+    // A compiled program checks the unused variable each time it runs, including once it is JIT-compiled
+    CompiledExpr program = native.compile("one(w) + y");
+    CHECK(errorOf(native, program) == "Undefined variable: w");
+    native.setVariable("w", 1.0);
+    for (int run = 0; run < 3; run++) CHECK(native.execute(program) == 5.0);
+    CHECK(program.jit != nullptr || !JitCompiler::isSupported());
+
+    // Batch evaluation: the dropped column is read but does not change the rows
+    const double ys[] = {1.0, 2.0, 3.0};
+    const double ws[] = {10.0, 20.0, 30.0};
+    double rows[3];
+    CompiledExpr batch = interpreter.compile("first(y, w) + one(w)");
+    interpreter.evaluateBatch(batch, ColumnMap{{"y", ys}, {"w", ws}}, 3, rows);
+    CHECK(rows[0] == 3.0 && rows[1] == 5.0 && rows[2] == 7.0);
+
+    // Binary session files run the same programs
+    const std::string filename = "/tmp/user_function_test.bin";
+    {
+        std::string binary = SessionBinary::fromText("one(x) = 1\nzero() = 0\none(undefinedVar)\nzero() + one(2)\n");
+        std::ofstream(filename, std::ios::binary).write(binary.data(), binary.size());
+    }
+    SessionBinary file;
+    file.load(filename);
+    Evaluator loaded;
+    std::vector<int> slots;
+    CompiledExpr scratch;
+    file.bindScope(0, loaded, slots);
+    std::string error;
+    try {
+        file.run(2, loaded, slots, scratch);
+    } catch (const std::runtime_error& e) {
+        error = e.what();
+    }
+    CHECK(error == "Undefined variable: undefinedVar");
+    CHECK(file.run(3, loaded, slots, scratch) == 1.0);
+
+    // Functions outlive "----" for the calculator, from text and from the binary file alike,
+    // with their free variables read by name in the later scopes; session_analyzer starts
+    // each session without them and gets the parser's error instead
+    const std::string sessions =
+        "k = 10\ndouble(x) = x * 2\nshifted(x) = x + k\n----\ndouble(3) + 1\nk = 20\nshifted(1)\n"
+        "----\nshifted(1, 2)\ndouble(x) = x * 3\ndouble(3)\n";
+    {
+        std::string binary = SessionBinary::fromText(sessions);
+        std::ofstream(filename, std::ios::binary).write(binary.data(), binary.size());
+    }
+    file.load(filename);
+    std::vector<std::string_view> lines;
+    for (size_t line = 0; line < file.lineCount(); line++) {
+        if (file.lineKind(line) != SessionBinaryFormat::SEPARATOR) lines.push_back(file.lineText(line));
+    }
+    Evaluator fromText;
+    Evaluator fromBinary;
+    CategoryResults textResults = ExpressionProcessor::processExpressions(lines, fromText);
+    CategoryResults binaryResults = ExpressionProcessor::processBinary(file, fromBinary);
+    CHECK(textResults.variables == binaryResults.variables);
+    CHECK(textResults.advanced == binaryResults.advanced);
+    CHECK(fromBinary.evaluate("k") == 20.0);
+    CHECK(file.lineText(4) == "double(3) + 1" && file.sessionError(4) == "Unknown function: double");
+    CHECK(file.sessionError(5).empty());
+    CHECK(file.sessionError(6) == "Unknown function: shifted");
+    CHECK(file.sessionError(8) == "Unknown function: shifted");  // not the arity error
+    CHECK(file.sessionError(9).empty() && file.sessionError(10).empty());  // redefined in its own session
+    std::remove(filename.c_str());
+
+    return CHECK_RESULT();
+}